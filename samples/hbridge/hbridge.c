@@ -4,6 +4,9 @@
  * SDPX-License-Identifier: Apache-2.0
  */
 
+#include <stdlib.h>
+#include <string.h>
+
 #include <zephyr/logging/log.h>
 
 #include "hbridge.h"
@@ -48,120 +51,665 @@ static int motors_init(struct nxp_hbridge *hbridge)
 	return 0;
 }
 
-static int motor_set_direction(struct nxp_hbridge *hbridge, int *gpios, int direction)
+static int invert_direction(int direction)
 {
-	int ret;
-	int gpio0_level, gpio1_level;
+	switch (direction) {
+	case NXP_HBRIDGE_DIRECTION_FORWARD:
+		return NXP_HBRIDGE_DIRECTION_BACKWARDS;
+	case NXP_HBRIDGE_DIRECTION_BACKWARDS:
+		return NXP_HBRIDGE_DIRECTION_FORWARD;
+	default:
+		return direction;
+	}
+}
 
-	/* sanity checks */
-	if (!hbridge || !hbridge->gpio_dev) {
-		return -EINVAL;
+/* compute the levels of a motor's GPIOs for the given direction */
+static int motor_get_levels(int *gpios, uint32_t flags, int direction,
+			    gpio_port_value_t *value)
+{
+	if (flags & NXP_HBRIDGE_MOTOR_INVERT) {
+		direction = invert_direction(direction);
 	}
 
 	switch (direction) {
 	case NXP_HBRIDGE_DIRECTION_OFF:
-		gpio0_level = 0;
-		gpio1_level = 0;
 		break;
 	case NXP_HBRIDGE_DIRECTION_FORWARD:
-		gpio0_level = 1;
-		gpio1_level = 0;
+		*value |= BIT(gpios[0]);
 		break;
 	case NXP_HBRIDGE_DIRECTION_BACKWARDS:
-		gpio0_level = 0;
-		gpio1_level = 1;
+		*value |= BIT(gpios[1]);
+		break;
+	case NXP_HBRIDGE_DIRECTION_BRAKE:
+		*value |= BIT(gpios[0]) | BIT(gpios[1]);
 		break;
 	default:
 		LOG_ERR("invalid direction: %d", direction);
 		return -EINVAL;
 	}
 
-	ret = gpio_pin_set(hbridge->gpio_dev, gpios[0], gpio0_level);
+	return 0;
+}
+
+static int motors_set_direction(struct nxp_hbridge *hbridge,
+				int ldirection, int rdirection)
+{
+	int ret;
+	gpio_port_value_t value;
+	k_spinlock_key_t key;
+
+	/* sanity checks */
+	if (!hbridge || !hbridge->gpio_dev) {
+		return -EINVAL;
+	}
+
+	value = 0;
+
+	ret = motor_get_levels(hbridge->lgpios, hbridge->lflags,
+			       ldirection, &value);
 	if (ret) {
-		LOG_ERR("failed to set GPIO 0 level to %d: %d", gpio0_level, ret);
+		LOG_ERR("failed to set left motor direction to %d: %d",
+			ldirection, ret);
 		return ret;
 	}
 
-	ret = gpio_pin_set(hbridge->gpio_dev, gpios[1], gpio1_level);
+	ret = motor_get_levels(hbridge->rgpios, hbridge->rflags,
+			       rdirection, &value);
 	if (ret) {
-		LOG_ERR("failed to set GPIO 1 level to %d: %d", gpio1_level, ret);
+		LOG_ERR("failed to set right motor direction to %d: %d",
+			rdirection, ret);
 		return ret;
 	}
 
-	LOG_DBG("GPIO %d: %d, GPIO %d: %d",
-		gpios[0], gpio0_level, gpios[1], gpio1_level);
+	/* all IN pins change at once so the motors never disagree */
+	ret = gpio_port_set_masked(hbridge->gpio_dev, hbridge->gpio_mask, value);
+	if (ret) {
+		LOG_ERR("failed to set GPIO levels to 0x%x: %d", value, ret);
+		return ret;
+	}
+
+	key = k_spin_lock(&hbridge->duty_lock);
+
+	hbridge->direction[0] = ldirection;
+	hbridge->direction[1] = rdirection;
+
+	k_spin_unlock(&hbridge->duty_lock, key);
+
+	LOG_DBG("GPIO mask: 0x%x, levels: 0x%x", hbridge->gpio_mask, value);
 
 	return 0;
 }
 
-static int invert_direction(int direction)
+static int motors_set_duty_cycle(struct nxp_hbridge *hbridge,
+				 uint32_t lduty_cycle, uint32_t rduty_cycle)
 {
-	switch (direction) {
-	case NXP_HBRIDGE_DIRECTION_FORWARD:
-		return NXP_HBRIDGE_DIRECTION_BACKWARDS;
-	case NXP_HBRIDGE_DIRECTION_BACKWARDS:
-		return NXP_HBRIDGE_DIRECTION_FORWARD;
-	default:
-		return direction;
+	int ret;
+	k_spinlock_key_t key;
+
+	/*
+	 * both channels are written back to back. The new duty cycles are
+	 * latched by the timer at the end of the current period, so they
+	 * both take effect on the same period.
+	 */
+	ret = pwm_set_cycles(hbridge->pwm_dev, hbridge->lchan,
+			     hbridge->period_cycles, lduty_cycle,
+			     PWM_POLARITY_NORMAL);
+	if (ret) {
+		LOG_ERR("failed to configure left PWM channel: %d", ret);
+		return ret;
+	}
+
+	ret = pwm_set_cycles(hbridge->pwm_dev, hbridge->rchan,
+			     hbridge->period_cycles, rduty_cycle,
+			     PWM_POLARITY_NORMAL);
+	if (ret) {
+		LOG_ERR("failed to configure right PWM channel: %d", ret);
+		return ret;
+	}
+
+	key = k_spin_lock(&hbridge->duty_lock);
+
+	hbridge->duty_cycle[0] = lduty_cycle;
+	hbridge->duty_cycle[1] = rduty_cycle;
+
+	k_spin_unlock(&hbridge->duty_lock, key);
+
+	return 0;
+}
+
+/* convert a speed into a duty cycle (in PWM clock cycles) */
+static uint32_t speed_to_cycles(struct nxp_hbridge *hbridge, int motor,
+				uint32_t speed)
+{
+	uint64_t cycles;
+
+	cycles = ((uint64_t)hbridge->period_cycles * speed) / NXP_HBRIDGE_MAX_SPEED;
+
+#ifdef CONFIG_NXPCUP_HBRIDGE_BATTERY
+	/* keep the average motor voltage the same as with a nominal battery */
+	if (hbridge->direction[motor] != NXP_HBRIDGE_DIRECTION_BRAKE) {
+		cycles = (cycles * CONFIG_NXPCUP_HBRIDGE_BATTERY_NOMINAL_MV * 1000) /
+			hbridge->battery_uv;
+		cycles = MIN(cycles, hbridge->period_cycles);
 	}
+#endif /* CONFIG_NXPCUP_HBRIDGE_BATTERY */
+
+	return cycles;
+}
+
+static int motors_set_speed(struct nxp_hbridge *hbridge,
+			    uint32_t lspeed, uint32_t rspeed)
+{
+	int ret;
+
+#ifdef CONFIG_NXPCUP_HBRIDGE_BATTERY
+	/* the speeds are applied again whenever the battery voltage changes */
+	k_mutex_lock(&hbridge->battery_lock, K_FOREVER);
+
+	hbridge->speed[0] = lspeed;
+	hbridge->speed[1] = rspeed;
+#endif /* CONFIG_NXPCUP_HBRIDGE_BATTERY */
+
+	ret = motors_set_duty_cycle(hbridge, speed_to_cycles(hbridge, 0, lspeed),
+				    speed_to_cycles(hbridge, 1, rspeed));
+
+#ifdef CONFIG_NXPCUP_HBRIDGE_BATTERY
+	k_mutex_unlock(&hbridge->battery_lock);
+#endif /* CONFIG_NXPCUP_HBRIDGE_BATTERY */
+
+	return ret;
 }
 
 int nxp_hbridge_set_direction(struct nxp_hbridge *hbridge, int direction)
 {
-	int ret, ldirection, rdirection;
+	return motors_set_direction(hbridge, direction, direction);
+}
 
-	ldirection = direction;
-	rdirection = direction;
+#ifdef CONFIG_NXPCUP_HBRIDGE_RAMP
+/* step a speed towards its target, stopping at 0 when changing direction */
+static int32_t ramp_step(int32_t current, int32_t target)
+{
+	int32_t next;
 
-	if (hbridge->lflags & NXP_HBRIDGE_MOTOR_INVERT) {
-		ldirection = invert_direction(direction);
+	if (target > current) {
+		next = MIN(current + CONFIG_NXPCUP_HBRIDGE_RAMP_STEP, target);
+	} else {
+		next = MAX(current - CONFIG_NXPCUP_HBRIDGE_RAMP_STEP, target);
 	}
 
-	if (hbridge->rflags & NXP_HBRIDGE_MOTOR_INVERT) {
-		rdirection = invert_direction(direction);
+	/* don't go through 0 in a single step */
+	if ((current < 0 && next > 0) || (current > 0 && next < 0)) {
+		return 0;
 	}
 
-	ret = motor_set_direction(hbridge, hbridge->lgpios, ldirection);
+	return next;
+}
+
+static void ramp_work_handler(struct k_work *work)
+{
+	int ret;
+	int32_t lspeed, rspeed;
+	k_spinlock_key_t key;
+	struct nxp_hbridge *hbridge;
+
+	hbridge = CONTAINER_OF(work, struct nxp_hbridge, ramp_work);
+
+	key = k_spin_lock(&hbridge->ramp_lock);
+
+	lspeed = ramp_step(hbridge->current[0], hbridge->target[0]);
+	rspeed = ramp_step(hbridge->current[1], hbridge->target[1]);
+
+	k_spin_unlock(&hbridge->ramp_lock, key);
+
+	ret = nxp_hbridge_set_motors(hbridge, lspeed, rspeed);
+
+	key = k_spin_lock(&hbridge->ramp_lock);
+
 	if (ret) {
-		LOG_ERR("failed to set left motor direction to %d: %d",
-			direction, ret);
+		LOG_ERR("failed to set motors to %d/%d: %d", lspeed, rspeed, ret);
+	} else {
+		hbridge->current[0] = lspeed;
+		hbridge->current[1] = rspeed;
+	}
+
+	/* the targets may have changed while the motors were being set */
+	if (ret || (hbridge->current[0] == hbridge->target[0] &&
+		    hbridge->current[1] == hbridge->target[1])) {
+		k_timer_stop(&hbridge->ramp_timer);
+		hbridge->ramping = false;
+	}
+
+	k_spin_unlock(&hbridge->ramp_lock, key);
+}
+
+static void ramp_timer_handler(struct k_timer *timer)
+{
+	struct nxp_hbridge *hbridge;
+
+	hbridge = CONTAINER_OF(timer, struct nxp_hbridge, ramp_timer);
+
+	/* GPIO and PWM drivers may sleep, so step from thread context */
+	k_work_submit(&hbridge->ramp_work);
+}
+
+static void ramp_init(struct nxp_hbridge *hbridge)
+{
+	hbridge->ramping = false;
+	hbridge->target[0] = 0;
+	hbridge->target[1] = 0;
+	hbridge->current[0] = 0;
+	hbridge->current[1] = 0;
+
+	k_timer_init(&hbridge->ramp_timer, ramp_timer_handler, NULL);
+	k_work_init(&hbridge->ramp_work, ramp_work_handler);
+}
+#endif /* CONFIG_NXPCUP_HBRIDGE_RAMP */
+
+#ifdef CONFIG_NXPCUP_HBRIDGE_ENCODER
+static void encoder_handler(const struct device *dev, struct gpio_callback *cb,
+			    gpio_port_pins_t pins)
+{
+	struct nxp_hbridge *hbridge;
+
+	hbridge = CONTAINER_OF(cb, struct nxp_hbridge, enc_cb);
+
+	if (pins & BIT(hbridge->enc_gpios[0])) {
+		atomic_inc(&hbridge->ticks[0]);
+	}
+
+	if (pins & BIT(hbridge->enc_gpios[1])) {
+		atomic_inc(&hbridge->ticks[1]);
+	}
+}
+
+static int encoder_init(struct nxp_hbridge *hbridge, int gpio)
+{
+	int ret;
+
+	ret = gpio_pin_configure(hbridge->enc_dev, gpio, GPIO_INPUT);
+	if (ret) {
+		LOG_ERR("failed to configure GPIO %d: %d", gpio, ret);
 		return ret;
 	}
 
-	ret = motor_set_direction(hbridge, hbridge->rgpios, rdirection);
+	ret = gpio_pin_interrupt_configure(hbridge->enc_dev, gpio,
+					   GPIO_INT_EDGE_BOTH);
+	if (ret) {
+		LOG_ERR("failed to configure GPIO %d interrupt: %d", gpio, ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+static int encoders_init(struct nxp_hbridge *hbridge)
+{
+	int ret;
+
+	/* sanity checks */
+	if (!hbridge->enc_dev || !hbridge->ticks_per_m ||
+	    hbridge->enc_gpios[0] >= GPIO_MAX_PINS_PER_PORT ||
+	    hbridge->enc_gpios[1] >= GPIO_MAX_PINS_PER_PORT) {
+		return -EINVAL;
+	}
+
+	atomic_set(&hbridge->ticks[0], 0);
+	atomic_set(&hbridge->ticks[1], 0);
+
+	gpio_init_callback(&hbridge->enc_cb, encoder_handler,
+			   BIT(hbridge->enc_gpios[0]) | BIT(hbridge->enc_gpios[1]));
+
+	ret = gpio_add_callback(hbridge->enc_dev, &hbridge->enc_cb);
+	if (ret) {
+		LOG_ERR("failed to add encoder callback: %d", ret);
+		return ret;
+	}
+
+	ret = encoder_init(hbridge, hbridge->enc_gpios[0]);
+	if (ret) {
+		LOG_ERR("failed to initialize left encoder: %d", ret);
+		return ret;
+	}
+
+	ret = encoder_init(hbridge, hbridge->enc_gpios[1]);
+	if (ret) {
+		LOG_ERR("failed to initialize right encoder: %d", ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * one step of the speed loop for a single motor. The gains are scaled
+ * such that an error of 1 m/s (P), 1 m (I) or 1 m/s^2 (D) contributes
+ * the gain's value to the speed (in permille).
+ */
+static int32_t pid_step(struct nxp_hbridge *hbridge, int motor,
+			int32_t setpoint, int32_t velocity)
+{
+	int32_t error;
+	int64_t integral, derivative, output;
+
+	error = setpoint - velocity;
+
+	/* mm/s integrated over the period, in um */
+	integral = hbridge->integral[motor] +
+		(int64_t)error * CONFIG_NXPCUP_HBRIDGE_PID_PERIOD_MS;
+
+	/* mm/s^2 */
+	derivative = ((int64_t)(error - hbridge->error[motor]) * MSEC_PER_SEC) /
+		CONFIG_NXPCUP_HBRIDGE_PID_PERIOD_MS;
+
+	output = ((int64_t)CONFIG_NXPCUP_HBRIDGE_PID_KP * error) / 1000 +
+		((int64_t)CONFIG_NXPCUP_HBRIDGE_PID_KI * integral) / 1000000 +
+		((int64_t)CONFIG_NXPCUP_HBRIDGE_PID_KD * derivative) / 1000;
+
+	/* stop integrating while saturated, otherwise the integral winds up */
+	if (output > NXP_HBRIDGE_MAX_SPEED) {
+		output = NXP_HBRIDGE_MAX_SPEED;
+		integral = MIN(integral, hbridge->integral[motor]);
+	} else if (output < -NXP_HBRIDGE_MAX_SPEED) {
+		output = -NXP_HBRIDGE_MAX_SPEED;
+		integral = MAX(integral, hbridge->integral[motor]);
+	}
+
+	hbridge->integral[motor] = integral;
+	hbridge->error[motor] = error;
+
+	return output;
+}
+
+/* convert a number of encoder edges in one period into mm/s */
+static int32_t ticks_to_velocity(struct nxp_hbridge *hbridge, int motor,
+				 atomic_val_t ticks)
+{
+	int32_t previous, output;
+	int64_t speed, resolution;
+	bool backwards;
+
+	speed = ((int64_t)ticks * 1000 * MSEC_PER_SEC) /
+		((int64_t)hbridge->ticks_per_m * CONFIG_NXPCUP_HBRIDGE_PID_PERIOD_MS);
+
+	/* velocity represented by a single edge */
+	resolution = (1000 * MSEC_PER_SEC) /
+		((int64_t)hbridge->ticks_per_m * CONFIG_NXPCUP_HBRIDGE_PID_PERIOD_MS);
+
+	previous = hbridge->velocity[motor];
+	output = hbridge->output[motor];
+
+	/*
+	 * the encoders only have one channel, so the direction is guessed.
+	 * A stopped wheel follows its motor. A spinning wheel keeps its
+	 * direction, unless it's getting faster while its motor is driven the
+	 * other way, meaning it went through 0 during the last period.
+	 */
+	if (!previous) {
+		backwards = output < 0;
+	} else if (output && (output < 0) != (previous < 0) &&
+		   speed > abs(previous) + resolution) {
+		backwards = output < 0;
+	} else {
+		backwards = previous < 0;
+	}
+
+	return backwards ? -speed : speed;
+}
+
+static void pid_work_handler(struct k_work *work)
+{
+	int ret;
+	int32_t setpoint[2], velocity[2], output[2];
+	k_spinlock_key_t key;
+	struct nxp_hbridge *hbridge;
+
+	hbridge = CONTAINER_OF(work, struct nxp_hbridge, pid_work);
+
+	velocity[0] = ticks_to_velocity(hbridge, 0,
+					atomic_clear(&hbridge->ticks[0]));
+	velocity[1] = ticks_to_velocity(hbridge, 1,
+					atomic_clear(&hbridge->ticks[1]));
+
+	key = k_spin_lock(&hbridge->pid_lock);
+
+	hbridge->velocity[0] = velocity[0];
+	hbridge->velocity[1] = velocity[1];
+	setpoint[0] = hbridge->setpoint[0];
+	setpoint[1] = hbridge->setpoint[1];
+
+	k_spin_unlock(&hbridge->pid_lock, key);
+
+	output[0] = pid_step(hbridge, 0, setpoint[0], velocity[0]);
+	output[1] = pid_step(hbridge, 1, setpoint[1], velocity[1]);
+
+	ret = nxp_hbridge_set_motors(hbridge, output[0], output[1]);
+	if (ret) {
+		LOG_ERR("failed to set motors to %d/%d: %d",
+			output[0], output[1], ret);
+		return;
+	}
+
+	hbridge->output[0] = output[0];
+	hbridge->output[1] = output[1];
+}
+
+static void pid_timer_handler(struct k_timer *timer)
+{
+	struct nxp_hbridge *hbridge;
+
+	hbridge = CONTAINER_OF(timer, struct nxp_hbridge, pid_timer);
+
+	/* GPIO and PWM drivers may sleep, so step from thread context */
+	k_work_submit(&hbridge->pid_work);
+}
+
+static int pid_init(struct nxp_hbridge *hbridge)
+{
+	int ret;
+
+	ret = encoders_init(hbridge);
+	if (ret) {
+		LOG_ERR("failed to initialize encoders: %d", ret);
+		return ret;
+	}
+
+	memset(hbridge->setpoint, 0, sizeof(hbridge->setpoint));
+	memset(hbridge->velocity, 0, sizeof(hbridge->velocity));
+	memset(hbridge->integral, 0, sizeof(hbridge->integral));
+	memset(hbridge->error, 0, sizeof(hbridge->error));
+	memset(hbridge->output, 0, sizeof(hbridge->output));
+
+	k_timer_init(&hbridge->pid_timer, pid_timer_handler, NULL);
+	k_work_init(&hbridge->pid_work, pid_work_handler);
+
+	/* the loop runs at a fixed rate, holding 0 mm/s until told otherwise */
+	k_timer_start(&hbridge->pid_timer,
+		      K_MSEC(CONFIG_NXPCUP_HBRIDGE_PID_PERIOD_MS),
+		      K_MSEC(CONFIG_NXPCUP_HBRIDGE_PID_PERIOD_MS));
+
+	return 0;
+}
+#endif /* CONFIG_NXPCUP_HBRIDGE_ENCODER */
+
+#ifdef CONFIG_NXPCUP_HBRIDGE_BATTERY
+static int battery_read(struct nxp_hbridge *hbridge, int32_t *uv)
+{
+	int ret;
+	int16_t sample;
+	int32_t mv;
+	struct adc_sequence sequence = {
+		.buffer = &sample,
+		.buffer_size = sizeof(sample),
+	};
+
+	ret = adc_sequence_init_dt(&hbridge->battery, &sequence);
+	if (ret) {
+		LOG_ERR("failed to initialize ADC sequence: %d", ret);
+		return ret;
+	}
+
+	ret = adc_read_dt(&hbridge->battery, &sequence);
+	if (ret) {
+		LOG_ERR("failed to read ADC: %d", ret);
+		return ret;
+	}
+
+	mv = sample;
+
+	ret = adc_raw_to_millivolts_dt(&hbridge->battery, &mv);
+	if (ret) {
+		LOG_ERR("failed to convert ADC sample: %d", ret);
+		return ret;
+	}
+
+	/* undo the voltage divider */
+	*uv = ((int64_t)mv * 1000 * (hbridge->battery_rtop + hbridge->battery_rbottom)) /
+		hbridge->battery_rbottom;
+
+	return 0;
+}
+
+static void battery_work_handler(struct k_work *work)
+{
+	int ret;
+	int32_t uv;
+	struct nxp_hbridge *hbridge;
+
+	hbridge = CONTAINER_OF(work, struct nxp_hbridge, battery_work);
+
+	ret = battery_read(hbridge, &uv);
+	if (ret) {
+		return;
+	}
+
+	k_mutex_lock(&hbridge->battery_lock, K_FOREVER);
+
+	/* first order IIR filter, rides out the sags of single current peaks */
+	hbridge->battery_uv += (uv - hbridge->battery_uv) /
+		(1 << CONFIG_NXPCUP_HBRIDGE_BATTERY_FILTER_SHIFT);
+
+	/* scale the duty cycles for the new voltage */
+	ret = motors_set_speed(hbridge, hbridge->speed[0], hbridge->speed[1]);
+	if (ret) {
+		LOG_ERR("failed to apply battery voltage: %d", ret);
+	}
+
+	k_mutex_unlock(&hbridge->battery_lock);
+}
+
+static void battery_timer_handler(struct k_timer *timer)
+{
+	struct nxp_hbridge *hbridge;
+
+	hbridge = CONTAINER_OF(timer, struct nxp_hbridge, battery_timer);
+
+	/* ADC drivers may sleep, so sample from thread context */
+	k_work_submit(&hbridge->battery_work);
+}
+
+static int battery_init(struct nxp_hbridge *hbridge)
+{
+	int ret;
+	int32_t uv;
+
+	/* sanity checks */
+	if (!hbridge->battery_rbottom) {
+		return -EINVAL;
+	}
+
+	if (!adc_is_ready_dt(&hbridge->battery)) {
+		LOG_ERR("ADC not ready");
+		return -ENODEV;
+	}
+
+	ret = adc_channel_setup_dt(&hbridge->battery);
+	if (ret) {
+		LOG_ERR("failed to configure ADC channel: %d", ret);
+		return ret;
+	}
+
+	/* start the filter from the actual voltage instead of 0 */
+	ret = battery_read(hbridge, &uv);
 	if (ret) {
-		LOG_ERR("failed to set right motor direction to %d: %d",
-			direction, ret);
 		return ret;
 	}
 
+	if (uv <= 0) {
+		LOG_ERR("invalid battery voltage: %d uV", uv);
+		return -EIO;
+	}
+
+	hbridge->battery_uv = uv;
+
+	/* ENA and ENB are fed 3.3V by nxp_hbridge_init() */
+	hbridge->speed[0] = NXP_HBRIDGE_MAX_SPEED;
+	hbridge->speed[1] = NXP_HBRIDGE_MAX_SPEED;
+
+	k_mutex_init(&hbridge->battery_lock);
+	k_timer_init(&hbridge->battery_timer, battery_timer_handler, NULL);
+	k_work_init(&hbridge->battery_work, battery_work_handler);
+
+	k_timer_start(&hbridge->battery_timer,
+		      K_MSEC(CONFIG_NXPCUP_HBRIDGE_BATTERY_PERIOD_MS),
+		      K_MSEC(CONFIG_NXPCUP_HBRIDGE_BATTERY_PERIOD_MS));
+
+	LOG_INF("battery voltage: %d mV", uv / 1000);
+
 	return 0;
 }
+#endif /* CONFIG_NXPCUP_HBRIDGE_BATTERY */
 
 int nxp_hbridge_init(struct nxp_hbridge *hbridge)
 {
 	int ret;
+	uint64_t cycles_per_sec, period_cycles;
 
 	/* sanity checks */
 	if (!hbridge || !hbridge->gpio_dev || !hbridge->pwm_dev) {
 		return -EINVAL;
 	}
 
-	/* ENA and ENB will initially be fed 3.3V */
-	ret = pwm_set(hbridge->pwm_dev, hbridge->lchan, hbridge->period,
-		      hbridge->period, PWM_POLARITY_NORMAL);
-	if (ret < 0) {
-		LOG_ERR("failed to configure left PWM channel: %d", ret);
+	/* all IN pins are written as a single port value */
+	if (hbridge->lgpios[0] >= GPIO_MAX_PINS_PER_PORT ||
+	    hbridge->lgpios[1] >= GPIO_MAX_PINS_PER_PORT ||
+	    hbridge->rgpios[0] >= GPIO_MAX_PINS_PER_PORT ||
+	    hbridge->rgpios[1] >= GPIO_MAX_PINS_PER_PORT) {
+		return -EINVAL;
+	}
+
+	/* both channels share the same timer, hence the same clock */
+	ret = pwm_get_cycles_per_sec(hbridge->pwm_dev, hbridge->lchan,
+				     &cycles_per_sec);
+	if (ret) {
+		LOG_ERR("failed to get PWM clock rate: %d", ret);
 		return ret;
 	}
 
-	ret = pwm_set(hbridge->pwm_dev, hbridge->rchan, hbridge->period,
-		      hbridge->period, PWM_POLARITY_NORMAL);
-	if (ret < 0) {
-		LOG_ERR("failed to configure right PWM channel: %d", ret);
+	period_cycles = (cycles_per_sec * hbridge->period) / NSEC_PER_SEC;
+	if (!period_cycles || period_cycles > UINT32_MAX) {
+		LOG_ERR("invalid period: %u ns at %u Hz",
+			hbridge->period, (uint32_t)cycles_per_sec);
+		return -EINVAL;
+	}
+
+	hbridge->period_cycles = period_cycles;
+
+	if (hbridge->period_cycles < NXP_HBRIDGE_MAX_SPEED) {
+		LOG_WRN("period only spans %u cycles, speed resolution is lost",
+			hbridge->period_cycles);
+	}
+
+	/* ENA and ENB will initially be fed 3.3V */
+	ret = motors_set_duty_cycle(hbridge, hbridge->period_cycles,
+				    hbridge->period_cycles);
+	if (ret) {
+		LOG_ERR("failed to configure PWM channels: %d", ret);
 		return ret;
 	}
 
+	hbridge->gpio_mask = BIT(hbridge->lgpios[0]) | BIT(hbridge->lgpios[1]) |
+		BIT(hbridge->rgpios[0]) | BIT(hbridge->rgpios[1]);
+
 	/* motors will initially be stopped */
 	ret = motors_init(hbridge);
 	if (ret) {
@@ -169,13 +717,36 @@ int nxp_hbridge_init(struct nxp_hbridge *hbridge)
 		return ret;
 	}
 
+	hbridge->direction[0] = NXP_HBRIDGE_DIRECTION_OFF;
+	hbridge->direction[1] = NXP_HBRIDGE_DIRECTION_OFF;
+
+#ifdef CONFIG_NXPCUP_HBRIDGE_BATTERY
+	/* must be running before anything sets the speed */
+	ret = battery_init(hbridge);
+	if (ret) {
+		LOG_ERR("failed to initialize battery sampling: %d", ret);
+		return ret;
+	}
+#endif /* CONFIG_NXPCUP_HBRIDGE_BATTERY */
+
+#ifdef CONFIG_NXPCUP_HBRIDGE_RAMP
+	ramp_init(hbridge);
+#endif /* CONFIG_NXPCUP_HBRIDGE_RAMP */
+
+#ifdef CONFIG_NXPCUP_HBRIDGE_ENCODER
+	ret = pid_init(hbridge);
+	if (ret) {
+		LOG_ERR("failed to initialize speed loop: %d", ret);
+		return ret;
+	}
+#endif /* CONFIG_NXPCUP_HBRIDGE_ENCODER */
+
 	return 0;
 }
 
 int nxp_hbridge_set_speed(struct nxp_hbridge *hbridge, uint32_t speed)
 {
 	int ret;
-	uint32_t duty_cycle;
 
 	/* sanity checks */
 	if (!hbridge || !hbridge->pwm_dev) {
@@ -188,23 +759,242 @@ int nxp_hbridge_set_speed(struct nxp_hbridge *hbridge, uint32_t speed)
 		return -EINVAL;
 	}
 
-	duty_cycle = (hbridge->period * speed) / NXP_HBRIDGE_MAX_SPEED;
+	ret = motors_set_speed(hbridge, speed, speed);
+	if (ret) {
+		return ret;
+	}
+
+	LOG_INF("set speed to %d", speed);
+
+	return 0;
+}
+
+/* split a signed speed into a direction and an unsigned speed */
+static int motor_get_command(int32_t speed, int *direction, uint32_t *uspeed)
+{
+	if (speed > NXP_HBRIDGE_MAX_SPEED || speed < -NXP_HBRIDGE_MAX_SPEED) {
+		LOG_ERR("exceeded maximum speed: %d (actual) vs %d (max)",
+			speed, NXP_HBRIDGE_MAX_SPEED);
+		return -EINVAL;
+	}
+
+	if (speed > 0) {
+		*direction = NXP_HBRIDGE_DIRECTION_FORWARD;
+	} else if (speed < 0) {
+		*direction = NXP_HBRIDGE_DIRECTION_BACKWARDS;
+		speed = -speed;
+	} else {
+		*direction = NXP_HBRIDGE_DIRECTION_OFF;
+	}
+
+	*uspeed = speed;
+
+	return 0;
+}
+
+int nxp_hbridge_set_motors(struct nxp_hbridge *hbridge, int32_t lspeed,
+			   int32_t rspeed)
+{
+	int ret, ldirection, rdirection;
+	uint32_t luspeed, ruspeed;
 
-	ret = pwm_set(hbridge->pwm_dev, hbridge->lchan, hbridge->period,
-		      duty_cycle, PWM_POLARITY_NORMAL);
+	/* sanity checks */
+	if (!hbridge || !hbridge->pwm_dev) {
+		return -EINVAL;
+	}
+
+	ret = motor_get_command(lspeed, &ldirection, &luspeed);
 	if (ret) {
-		LOG_ERR("failed to configure left PWM channel: %d", ret);
 		return ret;
 	}
 
-	ret = pwm_set(hbridge->pwm_dev, hbridge->rchan, hbridge->period,
-		      duty_cycle, PWM_POLARITY_NORMAL);
-	if (ret < 0) {
-		LOG_ERR("failed to configure right PWM channel: %d", ret);
+	ret = motor_get_command(rspeed, &rdirection, &ruspeed);
+	if (ret) {
 		return ret;
 	}
 
-	LOG_INF("set speed to %d", speed);
+	ret = motors_set_direction(hbridge, ldirection, rdirection);
+	if (ret) {
+		LOG_ERR("failed to set motor directions: %d", ret);
+		return ret;
+	}
+
+	ret = motors_set_speed(hbridge, luspeed, ruspeed);
+	if (ret) {
+		LOG_ERR("failed to set motor duty cycles: %d", ret);
+		return ret;
+	}
+
+	LOG_DBG("set motors to %d (left), %d (right)", lspeed, rspeed);
+
+	return 0;
+}
+
+int nxp_hbridge_brake(struct nxp_hbridge *hbridge, uint32_t lstrength,
+		      uint32_t rstrength)
+{
+	int ret;
+
+	/* sanity checks */
+	if (!hbridge || !hbridge->pwm_dev) {
+		return -EINVAL;
+	}
+
+	if (lstrength > NXP_HBRIDGE_MAX_SPEED || rstrength > NXP_HBRIDGE_MAX_SPEED) {
+		LOG_ERR("exceeded maximum strength: %d/%d (actual) vs %d (max)",
+			lstrength, rstrength, NXP_HBRIDGE_MAX_SPEED);
+		return -EINVAL;
+	}
+
+	ret = motors_set_direction(hbridge, NXP_HBRIDGE_DIRECTION_BRAKE,
+				   NXP_HBRIDGE_DIRECTION_BRAKE);
+	if (ret) {
+		LOG_ERR("failed to set motor directions: %d", ret);
+		return ret;
+	}
+
+	ret = motors_set_speed(hbridge, lstrength, rstrength);
+	if (ret) {
+		LOG_ERR("failed to set motor duty cycles: %d", ret);
+		return ret;
+	}
+
+	LOG_DBG("set braking strength to %d (left), %d (right)",
+		lstrength, rstrength);
+
+	return 0;
+}
+
+/* convert a duty cycle into a permille, signed after the direction */
+static int32_t duty_cycle_to_permille(struct nxp_hbridge *hbridge, int motor)
+{
+	int32_t permille;
+
+	permille = ((uint64_t)hbridge->duty_cycle[motor] * NXP_HBRIDGE_MAX_SPEED) /
+		hbridge->period_cycles;
+
+	switch (hbridge->direction[motor]) {
+	case NXP_HBRIDGE_DIRECTION_FORWARD:
+		return permille;
+	case NXP_HBRIDGE_DIRECTION_BACKWARDS:
+		return -permille;
+	default:
+		return 0;
+	}
+}
+
+int nxp_hbridge_get_duty_cycle(struct nxp_hbridge *hbridge, int32_t *lduty_cycle,
+			       int32_t *rduty_cycle)
+{
+	k_spinlock_key_t key;
+
+	/* sanity checks */
+	if (!hbridge || !hbridge->period_cycles || !lduty_cycle || !rduty_cycle) {
+		return -EINVAL;
+	}
+
+	key = k_spin_lock(&hbridge->duty_lock);
+
+	*lduty_cycle = duty_cycle_to_permille(hbridge, 0);
+	*rduty_cycle = duty_cycle_to_permille(hbridge, 1);
+
+	k_spin_unlock(&hbridge->duty_lock, key);
+
+	return 0;
+}
+
+#ifdef CONFIG_NXPCUP_HBRIDGE_RAMP
+int nxp_hbridge_set_target(struct nxp_hbridge *hbridge, int32_t lspeed,
+			   int32_t rspeed)
+{
+	k_spinlock_key_t key;
+
+	/* sanity checks */
+	if (!hbridge) {
+		return -EINVAL;
+	}
+
+	if (lspeed > NXP_HBRIDGE_MAX_SPEED || lspeed < -NXP_HBRIDGE_MAX_SPEED ||
+	    rspeed > NXP_HBRIDGE_MAX_SPEED || rspeed < -NXP_HBRIDGE_MAX_SPEED) {
+		LOG_ERR("exceeded maximum speed: %d/%d (actual) vs %d (max)",
+			lspeed, rspeed, NXP_HBRIDGE_MAX_SPEED);
+		return -EINVAL;
+	}
+
+	key = k_spin_lock(&hbridge->ramp_lock);
+
+	hbridge->target[0] = lspeed;
+	hbridge->target[1] = rspeed;
+
+	if (!hbridge->ramping) {
+		hbridge->ramping = true;
+		k_timer_start(&hbridge->ramp_timer,
+			      K_MSEC(CONFIG_NXPCUP_HBRIDGE_RAMP_PERIOD_MS),
+			      K_MSEC(CONFIG_NXPCUP_HBRIDGE_RAMP_PERIOD_MS));
+	}
+
+	k_spin_unlock(&hbridge->ramp_lock, key);
+
+	return 0;
+}
+#endif /* CONFIG_NXPCUP_HBRIDGE_RAMP */
+
+#ifdef CONFIG_NXPCUP_HBRIDGE_ENCODER
+int nxp_hbridge_set_velocity(struct nxp_hbridge *hbridge, int32_t lvelocity,
+			     int32_t rvelocity)
+{
+	k_spinlock_key_t key;
+
+	/* sanity checks */
+	if (!hbridge) {
+		return -EINVAL;
+	}
+
+	key = k_spin_lock(&hbridge->pid_lock);
+
+	hbridge->setpoint[0] = lvelocity;
+	hbridge->setpoint[1] = rvelocity;
+
+	k_spin_unlock(&hbridge->pid_lock, key);
+
+	return 0;
+}
+
+int nxp_hbridge_get_velocity(struct nxp_hbridge *hbridge, int32_t *lvelocity,
+			     int32_t *rvelocity)
+{
+	k_spinlock_key_t key;
+
+	/* sanity checks */
+	if (!hbridge || !lvelocity || !rvelocity) {
+		return -EINVAL;
+	}
+
+	key = k_spin_lock(&hbridge->pid_lock);
+
+	*lvelocity = hbridge->velocity[0];
+	*rvelocity = hbridge->velocity[1];
+
+	k_spin_unlock(&hbridge->pid_lock, key);
+
+	return 0;
+}
+#endif /* CONFIG_NXPCUP_HBRIDGE_ENCODER */
+
+#ifdef CONFIG_NXPCUP_HBRIDGE_BATTERY
+int nxp_hbridge_get_battery(struct nxp_hbridge *hbridge, int32_t *mv)
+{
+	/* sanity checks */
+	if (!hbridge || !mv) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&hbridge->battery_lock, K_FOREVER);
+
+	*mv = hbridge->battery_uv / 1000;
+
+	k_mutex_unlock(&hbridge->battery_lock);
 
 	return 0;
 }
+#endif /* CONFIG_NXPCUP_HBRIDGE_BATTERY */
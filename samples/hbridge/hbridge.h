@@ -17,11 +17,17 @@
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/drivers/pwm.h>
 
+#include <zephyr/kernel.h>
+
+#ifdef CONFIG_NXPCUP_HBRIDGE_BATTERY
+#include <zephyr/drivers/adc.h>
+#endif /* CONFIG_NXPCUP_HBRIDGE_BATTERY */
+
 /** maximum number of GPIOs per motor */
 #define NXP_HBRIDGE_NUM_GPIOS 2
 
-/** maximum allowed speed */
-#define NXP_HBRIDGE_MAX_SPEED 100
+/** maximum allowed speed (i.e. full speed, speeds are in permille) */
+#define NXP_HBRIDGE_MAX_SPEED 1000
 
 /**
  * @defgroup MotorFlags
@@ -48,6 +54,8 @@ struct nxp_hbridge {
 	const struct device *pwm_dev;
 	/** left/right PWM channel period (in nanoseconds) */
 	uint32_t period;
+	/** left/right PWM channel period (in cycles), set by nxp_hbridge_init() */
+	uint32_t period_cycles;
 	/** left GPIO pins */
 	int lgpios[NXP_HBRIDGE_NUM_GPIOS];
 	/** right GPIO pins */
@@ -60,6 +68,74 @@ struct nxp_hbridge {
 	uint32_t lflags;
 	/** right motor flags - one of \ref MotorFlags */
 	uint32_t rflags;
+	/** mask of the left and right GPIO pins, set by nxp_hbridge_init() */
+	gpio_port_pins_t gpio_mask;
+	/** protects the duty cycles and directions below */
+	struct k_spinlock duty_lock;
+	/** left/right duty cycles currently applied (in cycles) */
+	uint32_t duty_cycle[2];
+	/** left/right directions currently applied */
+	int direction[2];
+#ifdef CONFIG_NXPCUP_HBRIDGE_RAMP
+	/** protects the ramp state below */
+	struct k_spinlock ramp_lock;
+	/** fires every CONFIG_NXPCUP_HBRIDGE_RAMP_PERIOD_MS while ramping */
+	struct k_timer ramp_timer;
+	/** takes a ramp step, outside of the timer's ISR context */
+	struct k_work ramp_work;
+	/** true while the timer is running */
+	bool ramping;
+	/** left/right target speeds, set by nxp_hbridge_set_target() */
+	int32_t target[2];
+	/** left/right speeds currently applied */
+	int32_t current[2];
+#endif /* CONFIG_NXPCUP_HBRIDGE_RAMP */
+#ifdef CONFIG_NXPCUP_HBRIDGE_ENCODER
+	/** pointer to the encoders' GPIO device */
+	const struct device *enc_dev;
+	/** left/right encoder GPIO pins */
+	int enc_gpios[2];
+	/** encoder edges per metre travelled by the wheel */
+	uint32_t ticks_per_m;
+	/** called on each encoder edge */
+	struct gpio_callback enc_cb;
+	/** left/right encoder edges since the last speed loop step */
+	atomic_t ticks[2];
+	/** fires every CONFIG_NXPCUP_HBRIDGE_PID_PERIOD_MS */
+	struct k_timer pid_timer;
+	/** takes a speed loop step, outside of the timer's ISR context */
+	struct k_work pid_work;
+	/** protects the set points and measured velocities */
+	struct k_spinlock pid_lock;
+	/** left/right velocities to hold (in mm/s) */
+	int32_t setpoint[2];
+	/** left/right velocities measured on the last step (in mm/s) */
+	int32_t velocity[2];
+	/** left/right integral of the velocity error (in um) */
+	int64_t integral[2];
+	/** left/right velocity error on the last step (in mm/s) */
+	int32_t error[2];
+	/** left/right speeds applied on the last step */
+	int32_t output[2];
+#endif /* CONFIG_NXPCUP_HBRIDGE_ENCODER */
+#ifdef CONFIG_NXPCUP_HBRIDGE_BATTERY
+	/** ADC channel measuring the battery voltage through a divider */
+	struct adc_dt_spec battery;
+	/** divider resistance between the battery and the ADC input (in ohms) */
+	uint32_t battery_rtop;
+	/** divider resistance between the ADC input and ground (in ohms) */
+	uint32_t battery_rbottom;
+	/** serializes the duty cycle updates with the battery sampling */
+	struct k_mutex battery_lock;
+	/** fires every CONFIG_NXPCUP_HBRIDGE_BATTERY_PERIOD_MS */
+	struct k_timer battery_timer;
+	/** samples the battery voltage, outside of the timer's ISR context */
+	struct k_work battery_work;
+	/** filtered battery voltage (in uV) */
+	int32_t battery_uv;
+	/** left/right unsigned speeds last set, scaled by the battery voltage */
+	uint32_t speed[2];
+#endif /* CONFIG_NXPCUP_HBRIDGE_BATTERY */
 };
 
 /**
@@ -67,17 +143,24 @@ struct nxp_hbridge {
  * @brief Represents the spinning direction of a motor
  */
 enum nxp_hbridge_direction {
-	/** motor is stopped/braking */
+	/** motor is coasting (IN pins low, the motor spins freely) */
 	NXP_HBRIDGE_DIRECTION_OFF = 0,
 	/** motor is spinning forward */
 	NXP_HBRIDGE_DIRECTION_FORWARD = 1,
 	/** motor is spinning backwards */
 	NXP_HBRIDGE_DIRECTION_BACKWARDS = 2,
+	/** motor is braking (IN pins high, the motor is shorted while enabled) */
+	NXP_HBRIDGE_DIRECTION_BRAKE = 3,
 };
 
 /**
  * @brief Initialize the L298 H-BRIDGE module.
  *
+ * Convert the PWM period into PWM clock cycles, such that setting the
+ * speed later on is only a matter of scaling it. For the speed to be set
+ * with a permille resolution, the period must span at least
+ * #NXP_HBRIDGE_MAX_SPEED cycles.
+ *
  * Put the L298 H-BRIDGE hardware into a known state. This consists of:
  *
  * - ENA and ENB pins set to logic HIGH.
@@ -104,17 +187,177 @@ int nxp_hbridge_set_direction(struct nxp_hbridge *hbridge, int direction);
 /**
  * @brief Set the speed of the car's motors.
  *
- * Set the speed of the car's motors based on a given percentage, where:
+ * Set the speed of the car's motors based on a given permille, where:
  *
- * - 0% means no speed (i.e. car is stopped/braking)
- * - 100% means full speed
+ * - 0 means no speed (i.e. ENA and ENB are low, the motors coast)
+ * - #NXP_HBRIDGE_MAX_SPEED means full speed
+ *
+ * With #NXP_HBRIDGE_DIRECTION_BRAKE, the speed is the braking strength
+ * instead - see nxp_hbridge_brake().
  *
  * @param hbridge pointer to the structure representing the H-BRIDGE
- * @param speed percentage to set (from 0% to 100%)
+ * @param speed permille to set (from 0 to #NXP_HBRIDGE_MAX_SPEED)
  *
  * @retval 0 on success
  * @retval negative errno code if failure
  */
 int nxp_hbridge_set_speed(struct nxp_hbridge *hbridge, uint32_t speed);
 
+/**
+ * @brief Set the speed and direction of each motor.
+ *
+ * Set the left and right motor speeds independently, based on signed
+ * permilles, where:
+ *
+ * - a positive value means spinning forward
+ * - a negative value means spinning backwards
+ * - 0 means the motor coasts (see #NXP_HBRIDGE_DIRECTION_OFF)
+ *
+ * All IN pins are updated in a single GPIO port write, followed by the
+ * ENA and ENB duty cycles, so the two motors never disagree for longer
+ * than it takes to update the PWM channels.
+ *
+ * @param hbridge pointer to the structure representing the H-BRIDGE
+ * @param lspeed left motor permille (from -#NXP_HBRIDGE_MAX_SPEED to
+ * #NXP_HBRIDGE_MAX_SPEED)
+ * @param rspeed right motor permille (from -#NXP_HBRIDGE_MAX_SPEED to
+ * #NXP_HBRIDGE_MAX_SPEED)
+ *
+ * @retval 0 on success
+ * @retval negative errno code if failure
+ */
+int nxp_hbridge_set_motors(struct nxp_hbridge *hbridge, int32_t lspeed,
+			   int32_t rspeed);
+
+/**
+ * @brief Brake each motor.
+ *
+ * Both IN pins of each motor are driven high. While its EN pin is high,
+ * the motor is shorted and its back EMF brakes it, stopping it in far
+ * less distance than coasting. The EN duty cycle sets the share of the
+ * time spent braking rather than coasting, hence the braking strength:
+ *
+ * - 0 means no braking (i.e. the motor coasts)
+ * - #NXP_HBRIDGE_MAX_SPEED means full braking
+ *
+ * The braking strength is not scaled for the battery voltage, as the
+ * braking current is driven by the motor rather than the battery.
+ *
+ * @param hbridge pointer to the structure representing the H-BRIDGE
+ * @param lstrength left motor braking strength (from 0 to #NXP_HBRIDGE_MAX_SPEED)
+ * @param rstrength right motor braking strength (from 0 to #NXP_HBRIDGE_MAX_SPEED)
+ *
+ * @retval 0 on success
+ * @retval negative errno code if failure
+ */
+int nxp_hbridge_brake(struct nxp_hbridge *hbridge, uint32_t lstrength,
+		      uint32_t rstrength);
+
+/**
+ * @brief Get the duty cycle driving each motor.
+ *
+ * The duty cycles are the ones currently applied to ENA and ENB, i.e.
+ * after scaling them for the battery voltage, and are signed after the
+ * spinning direction:
+ *
+ * - a positive value means the motor is driven forward
+ * - a negative value means the motor is driven backwards
+ * - 0 means the motor isn't driven (i.e. it coasts or brakes)
+ *
+ * Never blocks, so it may be called from an ISR.
+ *
+ * @param hbridge pointer to the structure representing the H-BRIDGE
+ * @param lduty_cycle left motor duty cycle (in permille of the PWM period)
+ * @param rduty_cycle right motor duty cycle (in permille of the PWM period)
+ *
+ * @retval 0 on success
+ * @retval negative errno code if failure
+ */
+int nxp_hbridge_get_duty_cycle(struct nxp_hbridge *hbridge, int32_t *lduty_cycle,
+			       int32_t *rduty_cycle);
+
+#ifdef CONFIG_NXPCUP_HBRIDGE_RAMP
+/**
+ * @brief Set the speed each motor should ramp to.
+ *
+ * Never blocks. The motor speeds are stepped towards the targets by at
+ * most CONFIG_NXPCUP_HBRIDGE_RAMP_STEP every CONFIG_NXPCUP_HBRIDGE_RAMP_PERIOD_MS
+ * from the system work queue, until they're reached. A motor changing
+ * direction is first ramped down to 0 and stopped for one period before
+ * ramping up the other way.
+ *
+ * Calling this again before the targets are reached replaces them. Must
+ * not be mixed with nxp_hbridge_set_direction(), nxp_hbridge_set_speed()
+ * or nxp_hbridge_set_motors().
+ *
+ * @param hbridge pointer to the structure representing the H-BRIDGE
+ * @param lspeed left motor target permille (from -#NXP_HBRIDGE_MAX_SPEED to
+ * #NXP_HBRIDGE_MAX_SPEED)
+ * @param rspeed right motor target permille (from -#NXP_HBRIDGE_MAX_SPEED to
+ * #NXP_HBRIDGE_MAX_SPEED)
+ *
+ * @retval 0 on success
+ * @retval negative errno code if failure
+ */
+int nxp_hbridge_set_target(struct nxp_hbridge *hbridge, int32_t lspeed,
+			   int32_t rspeed);
+#endif /* CONFIG_NXPCUP_HBRIDGE_RAMP */
+
+#ifdef CONFIG_NXPCUP_HBRIDGE_ENCODER
+/**
+ * @brief Set the velocity each wheel should hold.
+ *
+ * Never blocks. Every CONFIG_NXPCUP_HBRIDGE_PID_PERIOD_MS, the velocity
+ * of each wheel is measured by counting its encoder edges, and the motor
+ * speed is corrected by a PID controller from the system work queue.
+ *
+ * The encoders only have one channel, so a wheel is assumed to keep
+ * spinning in the same direction until it stops, and to then follow the
+ * direction its motor is driven in.
+ *
+ * Must not be mixed with nxp_hbridge_set_direction(),
+ * nxp_hbridge_set_speed() or nxp_hbridge_set_motors().
+ *
+ * @param hbridge pointer to the structure representing the H-BRIDGE
+ * @param lvelocity left wheel velocity (in mm/s, negative means backwards)
+ * @param rvelocity right wheel velocity (in mm/s, negative means backwards)
+ *
+ * @retval 0 on success
+ * @retval negative errno code if failure
+ */
+int nxp_hbridge_set_velocity(struct nxp_hbridge *hbridge, int32_t lvelocity,
+			     int32_t rvelocity);
+
+/**
+ * @brief Get the velocity of each wheel.
+ *
+ * @param hbridge pointer to the structure representing the H-BRIDGE
+ * @param lvelocity left wheel velocity measured on the last step (in mm/s)
+ * @param rvelocity right wheel velocity measured on the last step (in mm/s)
+ *
+ * @retval 0 on success
+ * @retval negative errno code if failure
+ */
+int nxp_hbridge_get_velocity(struct nxp_hbridge *hbridge, int32_t *lvelocity,
+			     int32_t *rvelocity);
+#endif /* CONFIG_NXPCUP_HBRIDGE_ENCODER */
+
+#ifdef CONFIG_NXPCUP_HBRIDGE_BATTERY
+/**
+ * @brief Get the battery voltage.
+ *
+ * The voltage is sampled every CONFIG_NXPCUP_HBRIDGE_BATTERY_PERIOD_MS
+ * and low-pass filtered. The duty cycles are scaled by
+ * CONFIG_NXPCUP_HBRIDGE_BATTERY_NOMINAL_MV over this voltage, such that
+ * a given speed always means the same average motor voltage.
+ *
+ * @param hbridge pointer to the structure representing the H-BRIDGE
+ * @param mv filtered battery voltage (in mV)
+ *
+ * @retval 0 on success
+ * @retval negative errno code if failure
+ */
+int nxp_hbridge_get_battery(struct nxp_hbridge *hbridge, int32_t *mv);
+#endif /* CONFIG_NXPCUP_HBRIDGE_BATTERY */
+
 #endif /* _HBRIDGE_H_ */
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <zephyr/logging/log.h>
+
+#ifdef CONFIG_ADC_EMUL
+#include <zephyr/drivers/adc/adc_emul.h>
+#endif /* CONFIG_ADC_EMUL */
+
+#include "hbridge_plant.h"
+
+LOG_MODULE_REGISTER(hbridge_plant);
+
+/* time taken to reach ~63% of a new velocity (in milliseconds) */
+#define PLANT_TIME_CONSTANT_MS		150
+#define PLANT_PERIOD_MS			1
+
+struct plant_wheel {
+	/* velocity (in um/s) */
+	int32_t velocity;
+	/* distance travelled since the last edge (in 1e-9 edges) */
+	uint64_t distance;
+	/* encoder GPIO level */
+	int level;
+};
+
+static struct nxp_hbridge *plant_hbridge;
+static struct plant_wheel plant_wheels[2];
+static int32_t plant_battery_mv = HBRIDGE_PLANT_NOMINAL_MV;
+
+static void plant_step(int motor, int32_t duty_cycle)
+{
+	int32_t target;
+	struct plant_wheel *wheel;
+
+	wheel = &plant_wheels[motor];
+
+	/* the motor voltage is the battery voltage, chopped by ENA/ENB */
+	target = ((int64_t)duty_cycle * HBRIDGE_PLANT_MAX_VELOCITY * plant_battery_mv) /
+		HBRIDGE_PLANT_NOMINAL_MV;
+
+	wheel->velocity += ((target - wheel->velocity) * PLANT_PERIOD_MS) /
+		PLANT_TIME_CONSTANT_MS;
+
+	wheel->distance += (uint64_t)abs(wheel->velocity) *
+		plant_hbridge->ticks_per_m * PLANT_PERIOD_MS;
+
+	while (wheel->distance >= 1000000000) {
+		wheel->distance -= 1000000000;
+		wheel->level = !wheel->level;
+		gpio_emul_input_set(plant_hbridge->enc_dev,
+				    plant_hbridge->enc_gpios[motor], wheel->level);
+	}
+}
+
+static void plant_timer_handler(struct k_timer *timer)
+{
+	int ret;
+	int32_t duty_cycle[2];
+
+	ret = nxp_hbridge_get_duty_cycle(plant_hbridge, &duty_cycle[0],
+					 &duty_cycle[1]);
+	if (ret) {
+		return;
+	}
+
+	plant_step(0, duty_cycle[0]);
+	plant_step(1, duty_cycle[1]);
+}
+
+K_TIMER_DEFINE(plant_timer, plant_timer_handler, NULL);
+
+/* feed the battery voltage to the ADC, through the voltage divider */
+static int plant_set_adc(struct nxp_hbridge *hbridge, int32_t mv)
+{
+#if defined(CONFIG_NXPCUP_HBRIDGE_BATTERY) && defined(CONFIG_ADC_EMUL)
+	return adc_emul_const_value_set(hbridge->battery.dev, hbridge->battery.channel_id,
+					((int64_t)mv * hbridge->battery_rbottom) /
+					(hbridge->battery_rtop + hbridge->battery_rbottom));
+#else
+	return 0;
+#endif /* CONFIG_NXPCUP_HBRIDGE_BATTERY && CONFIG_ADC_EMUL */
+}
+
+int hbridge_plant_set_battery(struct nxp_hbridge *hbridge, int32_t mv)
+{
+	int ret;
+
+	/* sanity checks */
+	if (!hbridge || mv <= 0) {
+		return -EINVAL;
+	}
+
+	ret = plant_set_adc(hbridge, mv);
+	if (ret) {
+		LOG_ERR("failed to set ADC input: %d", ret);
+		return ret;
+	}
+
+	plant_battery_mv = mv;
+
+	return 0;
+}
+
+int hbridge_plant_start(struct nxp_hbridge *hbridge)
+{
+	/* sanity checks */
+	if (!hbridge || !hbridge->enc_dev) {
+		return -EINVAL;
+	}
+
+	plant_hbridge = hbridge;
+
+	k_timer_start(&plant_timer, K_MSEC(PLANT_PERIOD_MS), K_MSEC(PLANT_PERIOD_MS));
+
+	return 0;
+}
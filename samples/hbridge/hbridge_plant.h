@@ -0,0 +1,59 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file hbridge_plant.h
+ * @brief Model of the motors, wheels and battery
+ *
+ * Without a car to drive, a first order model of the motors and wheels
+ * spins in their place. It produces the encoder edges through the emulated
+ * GPIO controller from the duty cycles applied to the motors and, with
+ * CONFIG_NXPCUP_HBRIDGE_BATTERY, feeds the battery voltage to the emulated
+ * ADC.
+ */
+
+#ifndef _HBRIDGE_PLANT_H_
+#define _HBRIDGE_PLANT_H_
+
+#include "hbridge.h"
+
+/** wheel velocity at full speed, with a nominal battery (in mm/s) */
+#define HBRIDGE_PLANT_MAX_VELOCITY	2000
+
+/** battery voltage giving #HBRIDGE_PLANT_MAX_VELOCITY at full speed (in mV) */
+#define HBRIDGE_PLANT_NOMINAL_MV	7400
+
+/**
+ * @brief Set the battery voltage.
+ *
+ * The motor voltage is the battery voltage, chopped by ENA and ENB. With
+ * CONFIG_NXPCUP_HBRIDGE_BATTERY, the voltage is also fed to the ADC
+ * channel of the H-BRIDGE, through its voltage divider, in which case
+ * this must be called before nxp_hbridge_init() samples it.
+ *
+ * @param hbridge pointer to the structure representing the H-BRIDGE
+ * @param mv battery voltage (in mV)
+ *
+ * @retval 0 on success
+ * @retval negative errno code if failure
+ */
+int hbridge_plant_set_battery(struct nxp_hbridge *hbridge, int32_t mv);
+
+/**
+ * @brief Start the model.
+ *
+ * The wheel velocities are stepped towards the ones given by the duty
+ * cycles of the motors every millisecond, from a timer. Must be called
+ * after nxp_hbridge_init().
+ *
+ * @param hbridge pointer to the structure representing the H-BRIDGE
+ *
+ * @retval 0 on success
+ * @retval negative errno code if failure
+ */
+int hbridge_plant_start(struct nxp_hbridge *hbridge);
+
+#endif /* _HBRIDGE_PLANT_H_ */
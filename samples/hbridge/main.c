@@ -10,10 +10,14 @@
 
 #include "hbridge.h"
 
+#ifdef CONFIG_NXPCUP_HBRIDGE_PLANT
+#include "hbridge_plant.h"
+#endif /* CONFIG_NXPCUP_HBRIDGE_PLANT */
+
 LOG_MODULE_REGISTER(main);
 
 /* PWM period in nanoseconds */
-#define HBRIDGE_PERIOD_NS		20000000
+#define HBRIDGE_PERIOD_NS		(NSEC_PER_SEC / CONFIG_NXPCUP_HBRIDGE_PWM_FREQUENCY)
 
 /* EXP_GPIO_IO02 connected to IN1 pin */
 #define HBRIDGE_IN1_GPIO		2
@@ -23,25 +27,160 @@ LOG_MODULE_REGISTER(main);
 #define HBRIDGE_IN3_GPIO		17
 /* EXP_GPIO_IO27 connected to IN4 pin */
 #define HBRIDGE_IN4_GPIO		27
-/* TPM3.CH1 connected to ENA pin via EXP_GPIO_IO20 */
+/* TPM4.CH1 connected to ENA pin via EXP_GPIO_IO21 */
 #define HBRIDGE_ENA_PWM_CHANNEL		1
-/* TPM3.CH2 connected to ENB pin via EXP_GPIO_IO12 */
+/* TPM4.CH2 connected to ENB pin via EXP_GPIO_IO13 */
 #define HBRIDGE_ENB_PWM_CHANNEL		2
 
-#define HBRIDGE_SPEED_STEP		10
+/* EXP_GPIO_IO05 connected to the left encoder output */
+#define HBRIDGE_LENC_GPIO		5
+/* EXP_GPIO_IO06 connected to the right encoder output */
+#define HBRIDGE_RENC_GPIO		6
+/*
+ * encoder edges per metre travelled by the wheel, e.g. 48 edges per motor
+ * revolution, 8:1 gearing and a 190 mm wheel circumference
+ */
+#define HBRIDGE_ENCODER_TICKS_PER_M	2000
+
+/* battery connected to the ADC input through a 47k/10k voltage divider */
+#define HBRIDGE_BATTERY_RTOP		47000
+#define HBRIDGE_BATTERY_RBOTTOM		10000
+
+/* speeds are in permille of the full speed */
+#define HBRIDGE_SPEED_STEP		100
+#define HBRIDGE_SLOW_SPEED		100
 
 static struct nxp_hbridge hbridge = {
 	.gpio_dev = DEVICE_DT_GET(DT_NODELABEL(gpio2)),
-	.pwm_dev = DEVICE_DT_GET(DT_NODELABEL(tpm3)),
+	.pwm_dev = DEVICE_DT_GET(DT_NODELABEL(tpm4)),
 	.period = HBRIDGE_PERIOD_NS,
 	.lgpios = { HBRIDGE_IN1_GPIO, HBRIDGE_IN2_GPIO },
 	.rgpios = { HBRIDGE_IN3_GPIO, HBRIDGE_IN4_GPIO },
 	.lchan = HBRIDGE_ENA_PWM_CHANNEL,
 	.rchan = HBRIDGE_ENB_PWM_CHANNEL,
 	.lflags = NXP_HBRIDGE_MOTOR_INVERT,
+#ifdef CONFIG_NXPCUP_HBRIDGE_ENCODER
+	.enc_dev = DEVICE_DT_GET(DT_NODELABEL(gpio2)),
+	.enc_gpios = { HBRIDGE_LENC_GPIO, HBRIDGE_RENC_GPIO },
+	.ticks_per_m = HBRIDGE_ENCODER_TICKS_PER_M,
+#endif /* CONFIG_NXPCUP_HBRIDGE_ENCODER */
+#ifdef CONFIG_NXPCUP_HBRIDGE_BATTERY
+	.battery = ADC_DT_SPEC_GET(DT_PATH(zephyr_user)),
+	.battery_rtop = HBRIDGE_BATTERY_RTOP,
+	.battery_rbottom = HBRIDGE_BATTERY_RBOTTOM,
+#endif /* CONFIG_NXPCUP_HBRIDGE_BATTERY */
 };
 
-#ifdef CONFIG_NXPCUP_DIRECTION_SAMPLE
+#ifdef CONFIG_NXPCUP_HBRIDGE_PLANT
+/*
+ * battery voltage when fully charged and empty (in mV). The battery of
+ * the model drains as the sample runs.
+ */
+#define PLANT_BATTERY_FULL_MV		8400
+#define PLANT_BATTERY_EMPTY_MV		6600
+/* battery voltage drop per second (in mV) */
+#define PLANT_BATTERY_DRAIN_MV		20
+
+static int32_t plant_battery_mv = PLANT_BATTERY_FULL_MV;
+
+/* drain the battery, replacing it with a charged one once empty */
+static int plant_drain_battery(struct nxp_hbridge *hbridge)
+{
+	plant_battery_mv -= PLANT_BATTERY_DRAIN_MV;
+	if (plant_battery_mv < PLANT_BATTERY_EMPTY_MV) {
+		plant_battery_mv = PLANT_BATTERY_FULL_MV;
+	}
+
+	return hbridge_plant_set_battery(hbridge, plant_battery_mv);
+}
+#endif /* CONFIG_NXPCUP_HBRIDGE_PLANT */
+
+#if defined(CONFIG_NXPCUP_HBRIDGE_ENCODER)
+/* wheel velocities held by the sample (in mm/s) */
+static const int32_t velocities[] = { 500, 1000, 300, -500, 0 };
+
+static int do_sample(struct nxp_hbridge *hbridge)
+{
+	int ret, j;
+	size_t i;
+	int32_t lvelocity, rvelocity;
+#ifdef CONFIG_NXPCUP_HBRIDGE_BATTERY
+	int32_t battery;
+#endif /* CONFIG_NXPCUP_HBRIDGE_BATTERY */
+
+#ifdef CONFIG_NXPCUP_HBRIDGE_PLANT
+	/* the battery has to be there before the H-BRIDGE samples it */
+	ret = hbridge_plant_set_battery(hbridge, plant_battery_mv);
+	if (ret) {
+		LOG_ERR("failed to set battery voltage: %d", ret);
+		return ret;
+	}
+#endif /* CONFIG_NXPCUP_HBRIDGE_PLANT */
+
+	ret = nxp_hbridge_init(hbridge);
+	if (ret) {
+		LOG_ERR("failed to initialize hbridge data: %d", ret);
+		return ret;
+	}
+
+#ifdef CONFIG_NXPCUP_HBRIDGE_PLANT
+	ret = hbridge_plant_start(hbridge);
+	if (ret) {
+		LOG_ERR("failed to start the model: %d", ret);
+		return ret;
+	}
+#endif /* CONFIG_NXPCUP_HBRIDGE_PLANT */
+
+	while (true) {
+		for (i = 0; i < ARRAY_SIZE(velocities); i++) {
+			ret = nxp_hbridge_set_velocity(hbridge, velocities[i],
+						       velocities[i]);
+			if (ret) {
+				LOG_ERR("failed to set velocity to %d: %d",
+					velocities[i], ret);
+				return ret;
+			}
+
+			/* hold each velocity for 3 seconds */
+			for (j = 0; j < 3; j++) {
+				k_sleep(K_MSEC(1000));
+
+				ret = nxp_hbridge_get_velocity(hbridge, &lvelocity,
+							       &rvelocity);
+				if (ret) {
+					LOG_ERR("failed to get velocity: %d", ret);
+					return ret;
+				}
+
+				LOG_INF("target: %d mm/s, left: %d mm/s, right: %d mm/s",
+					velocities[i], lvelocity, rvelocity);
+
+#ifdef CONFIG_NXPCUP_HBRIDGE_BATTERY
+				ret = nxp_hbridge_get_battery(hbridge, &battery);
+				if (ret) {
+					LOG_ERR("failed to get battery voltage: %d", ret);
+					return ret;
+				}
+
+				LOG_INF("battery: %d mV", battery);
+#endif /* CONFIG_NXPCUP_HBRIDGE_BATTERY */
+
+#ifdef CONFIG_NXPCUP_HBRIDGE_PLANT
+				ret = plant_drain_battery(hbridge);
+				if (ret) {
+					LOG_ERR("failed to drain battery: %d", ret);
+					return ret;
+				}
+#endif /* CONFIG_NXPCUP_HBRIDGE_PLANT */
+			}
+		}
+	}
+
+	LOG_INF("sample executed successfully!");
+
+	return 0;
+}
+#elif defined(CONFIG_NXPCUP_DIRECTION_SAMPLE)
 /* go into given direction for given miliseconds */
 static int do_direction_for_ms(struct nxp_hbridge *hbridge, int direction, int ms)
 {
@@ -57,6 +196,40 @@ static int do_direction_for_ms(struct nxp_hbridge *hbridge, int direction, int m
 
 	return 0;
 }
+
+/* brake with given strength for given miliseconds */
+static int do_brake_for_ms(struct nxp_hbridge *hbridge, uint32_t strength, int ms)
+{
+	int ret;
+
+	ret = nxp_hbridge_brake(hbridge, strength, strength);
+	if (ret) {
+		LOG_ERR("failed to brake with strength %d: %d", strength, ret);
+		return ret;
+	}
+
+	k_sleep(K_MSEC(ms));
+
+	return 0;
+}
+
+/* spin the motors at given signed speeds for given miliseconds */
+static int do_motors_for_ms(struct nxp_hbridge *hbridge, int32_t lspeed,
+			    int32_t rspeed, int ms)
+{
+	int ret;
+
+	ret = nxp_hbridge_set_motors(hbridge, lspeed, rspeed);
+	if (ret) {
+		LOG_ERR("failed to set motors to %d/%d: %d", lspeed, rspeed, ret);
+		return ret;
+	}
+
+	k_sleep(K_MSEC(ms));
+
+	return 0;
+}
+
 static int do_sample(struct nxp_hbridge *hbridge)
 {
 	int ret;
@@ -68,9 +241,9 @@ static int do_sample(struct nxp_hbridge *hbridge)
 	}
 
 	/* set speed to 10% */
-	ret = nxp_hbridge_set_speed(hbridge, 10);
+	ret = nxp_hbridge_set_speed(hbridge, HBRIDGE_SLOW_SPEED);
 	if (ret) {
-		LOG_ERR("failed to set speed to 10: %d", ret);
+		LOG_ERR("failed to set speed to %d: %d", HBRIDGE_SLOW_SPEED, ret);
 		return ret;
 	}
 
@@ -83,11 +256,18 @@ static int do_sample(struct nxp_hbridge *hbridge)
 			return ret;
 		}
 
-		/* stop for 1 second */
-		ret = do_direction_for_ms(hbridge,
-					  NXP_HBRIDGE_DIRECTION_OFF, 1000);
+		/* brake for 1 second */
+		ret = do_brake_for_ms(hbridge, NXP_HBRIDGE_MAX_SPEED, 1000);
 		if (ret) {
-			LOG_ERR("failed to stop the car: %d", ret);
+			LOG_ERR("failed to brake the car: %d", ret);
+			return ret;
+		}
+
+		/* restore the speed changed by the brake */
+		ret = nxp_hbridge_set_speed(hbridge, HBRIDGE_SLOW_SPEED);
+		if (ret) {
+			LOG_ERR("failed to set speed to %d: %d",
+				HBRIDGE_SLOW_SPEED, ret);
 			return ret;
 		}
 
@@ -100,13 +280,36 @@ static int do_sample(struct nxp_hbridge *hbridge)
 			return ret;
 		}
 
-		/* stop for 1 second */
+		/* coast for 1 second */
 		ret = do_direction_for_ms(hbridge,
 					  NXP_HBRIDGE_DIRECTION_OFF, 1000);
 		if (ret) {
 			LOG_ERR("failed to stop the car: %d", ret);
 			return ret;
 		}
+
+		/* spin in place for 5 seconds */
+		ret = do_motors_for_ms(hbridge, HBRIDGE_SLOW_SPEED,
+				       -HBRIDGE_SLOW_SPEED, 5000);
+		if (ret) {
+			LOG_ERR("failed to spin in place: %d", ret);
+			return ret;
+		}
+
+		/* stop for 1 second */
+		ret = do_motors_for_ms(hbridge, 0, 0, 1000);
+		if (ret) {
+			LOG_ERR("failed to stop the car: %d", ret);
+			return ret;
+		}
+
+		/* restore the speed changed by the spin */
+		ret = nxp_hbridge_set_speed(hbridge, HBRIDGE_SLOW_SPEED);
+		if (ret) {
+			LOG_ERR("failed to set speed to %d: %d",
+				HBRIDGE_SLOW_SPEED, ret);
+			return ret;
+		}
 	}
 
 	LOG_INF("sample executed successfully!");
@@ -114,6 +317,16 @@ static int do_sample(struct nxp_hbridge *hbridge)
 	return 0;
 }
 #else
+static int set_speed(struct nxp_hbridge *hbridge, uint32_t speed)
+{
+#ifdef CONFIG_NXPCUP_HBRIDGE_RAMP
+	/* returns right away, the speed is reached in the background */
+	return nxp_hbridge_set_target(hbridge, speed, speed);
+#else
+	return nxp_hbridge_set_speed(hbridge, speed);
+#endif /* CONFIG_NXPCUP_HBRIDGE_RAMP */
+}
+
 static int do_sample(struct nxp_hbridge *hbridge)
 {
 	int ret;
@@ -127,6 +340,7 @@ static int do_sample(struct nxp_hbridge *hbridge)
 		return ret;
 	}
 
+#ifndef CONFIG_NXPCUP_HBRIDGE_RAMP
 	ret = nxp_hbridge_set_direction(hbridge,
 					NXP_HBRIDGE_DIRECTION_FORWARD);
 	if (ret) {
@@ -134,9 +348,10 @@ static int do_sample(struct nxp_hbridge *hbridge)
 			NXP_HBRIDGE_DIRECTION_FORWARD, ret);
 		return ret;
 	}
+#endif /* CONFIG_NXPCUP_HBRIDGE_RAMP */
 
 	while (true) {
-		ret = nxp_hbridge_set_speed(hbridge, speed);
+		ret = set_speed(hbridge, speed);
 		if (ret) {
 			LOG_ERR("failed to set speed to %d: %d", speed, ret);
 			return ret;
@@ -155,7 +370,7 @@ static int do_sample(struct nxp_hbridge *hbridge)
 
 	return 0;
 }
-#endif /* CONFIG_NXPCUP_DIRECTION_SAMPLE */
+#endif /* CONFIG_NXPCUP_HBRIDGE_ENCODER */
 
 int main(void)
 {
@@ -5,29 +5,56 @@
  *
  * Demonstrate the functionality of the Pixy2 camera
  *
- * VERY IMPORTANT:
+ * NOTE:
  *
  * If your Pixy2 camera is powered from an independent source (i.e. if you
  * power off the board's power, the Pixy2 camera remains powered on) (e.g. USB
- * cable) and you with to re-run this sample (e.g. by power cycling the board),
- * please make sure you also power cycle the Pixy2 camera. Chances are you'll
- * stop the board in the middle of a transaction. Consequently, if the camera
- * is not reset, it will keep its state from the previous iteration and will
- * end up sending invalid data over during the next run of the sample. This
- * behaviour was especially observed with SPI.
+ * cable) and you wish to re-run this sample (e.g. by power cycling the board),
+ * chances are you'll stop the board in the middle of a transaction. The camera
+ * will then keep its state from the previous run and send invalid data over.
+ * To deal with this, the sample recovers the camera before using it, which
+ * takes a few milliseconds. The protocol layer does the same whenever the
+ * camera goes out of sync during operation. Power cycling the camera is only
+ * needed if recovery fails.
  */
 
+#include <stdlib.h>
+
+#include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 
 #include "pixy2_command.h"
 
+#ifdef CONFIG_NXPCUP_PIXY2_CAMERA
+#include "pixy2_camera.h"
+#endif /* CONFIG_NXPCUP_PIXY2_CAMERA */
+
+#ifdef CONFIG_NXPCUP_PIXY2_CALIBRATION
+#include "pixy2_calibration.h"
+#endif /* CONFIG_NXPCUP_PIXY2_CALIBRATION */
+
+#ifdef CONFIG_NXPCUP_PIXY2_ARBITER
+#include "pixy2_arbiter.h"
+#endif /* CONFIG_NXPCUP_PIXY2_ARBITER */
+
 LOG_MODULE_REGISTER(main);
 
 #define PIXY2_INTERPOLATION_STEPS	100
 
-#define PIXY2_TRANSPORT_PTR(transport)			\
-	COND_CODE_1(CONFIG_NXPCUP_PIXY2_I2C_TRANSPORT,	\
-		    (&(transport)->t), (transport))
+/* time between two interpolation steps when the LED updates are posted */
+#define PIXY2_INTERPOLATION_PERIOD_MS	10
+
+/* number of request/reply pairs used for measuring the throughput */
+#define PIXY2_BENCHMARK_ITERATIONS	1000
+
+/* priority of the frame acquisition thread */
+#define PIXY2_CAMERA_THREAD_PRIORITY	5
+
+/* frames further apart than this are not considered simultaneous */
+#define PIXY2_CAMERA_MAX_SKEW_US	10000
+
+/* number of RTIO queue entries - enough for one request/reply pair */
+#define PIXY2_RTIO_QUEUE_SIZE		4
 
 static struct pixy2_led colors[] = {
 	{ .red = 255, .green = 0, .blue = 0 },
@@ -35,70 +62,348 @@ static struct pixy2_led colors[] = {
 	{ .red = 0, .green = 0, .blue = 255 },
 };
 
-static int interpolate(struct pixy2_transport *t,
-		       struct pixy2_led *start,
-		       struct pixy2_led *end)
+#ifdef CONFIG_NXPCUP_PIXY2_I2C_TRANSPORT
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+RTIO_DEFINE(pixy2_i2c_rtio, PIXY2_RTIO_QUEUE_SIZE, PIXY2_RTIO_QUEUE_SIZE);
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
+
+static struct pixy2_i2c_transport i2c_transport = {
+	.t.ctlr = DEVICE_DT_GET(DT_NODELABEL(lpi2c3)),
+	.t.name = "i2c",
+	.t.api = COND_CODE_1(CONFIG_NXPCUP_PIXY2_I2C_COMBINED,
+			     (&pixy2_transport_i2c_xfer_api),
+			     (&pixy2_transport_i2c_api)),
+	IF_ENABLED(CONFIG_NXPCUP_PIXY2_RTIO, (.t.r = &pixy2_i2c_rtio,))
+#define PIXY2_I2C_ADDRESS		0x54
+	.address = PIXY2_I2C_ADDRESS,
+};
+#endif /* CONFIG_NXPCUP_PIXY2_I2C_TRANSPORT */
+
+#ifdef CONFIG_NXPCUP_PIXY2_SPI_TRANSPORT
+/* one camera per chip select, starting from 0 */
+#define PIXY2_SPI_RTIO_DEFINE(idx, _)					\
+	RTIO_DEFINE(pixy2_spi_rtio_##idx, PIXY2_RTIO_QUEUE_SIZE,	\
+		    PIXY2_RTIO_QUEUE_SIZE)
+
+#define PIXY2_SPI_TRANSPORT(idx, _)					\
+	{								\
+		.t.ctlr = DEVICE_DT_GET(DT_NODELABEL(lpspi3)),		\
+		.t.name = "spi" STRINGIFY(idx),				\
+		.t.api = &pixy2_transport_spi_api,			\
+		IF_ENABLED(CONFIG_NXPCUP_PIXY2_RTIO,			\
+			   (.t.r = &pixy2_spi_rtio_##idx,))		\
+		.sidx = idx,						\
+	}
+
+#define PIXY2_SPI_TRANSPORT_PTR(idx, _) (&spi_transports[idx].t)
+
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+LISTIFY(CONFIG_NXPCUP_PIXY2_SPI_NUM_CAMERAS, PIXY2_SPI_RTIO_DEFINE, (;));
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
+
+static struct pixy2_spi_transport spi_transports[] = {
+	LISTIFY(CONFIG_NXPCUP_PIXY2_SPI_NUM_CAMERAS, PIXY2_SPI_TRANSPORT, (,))
+};
+#endif /* CONFIG_NXPCUP_PIXY2_SPI_TRANSPORT */
+
+#if !defined(CONFIG_NXPCUP_PIXY2_I2C_TRANSPORT) && \
+	!defined(CONFIG_NXPCUP_PIXY2_SPI_TRANSPORT)
+#error "No transport protocol selected"
+#endif
+
+/* one transport per camera */
+static struct pixy2_transport *transports[] = {
+#ifdef CONFIG_NXPCUP_PIXY2_I2C_TRANSPORT
+	&i2c_transport.t,
+#endif /* CONFIG_NXPCUP_PIXY2_I2C_TRANSPORT */
+#ifdef CONFIG_NXPCUP_PIXY2_SPI_TRANSPORT
+	LISTIFY(CONFIG_NXPCUP_PIXY2_SPI_NUM_CAMERAS, PIXY2_SPI_TRANSPORT_PTR, (,)),
+#endif /* CONFIG_NXPCUP_PIXY2_SPI_TRANSPORT */
+};
+
+#ifdef CONFIG_NXPCUP_PIXY2_ARBITER
+/* one arbiter per transport, same order as transports[] */
+static struct pixy2_arbiter arbiters[ARRAY_SIZE(transports)];
+
+/*
+ * the LED updates are only posted, so they never delay a frame. If the
+ * camera is busy, the update goes out on a later step or is replaced by
+ * a newer one.
+ */
+static int set_led(size_t idx, struct pixy2_led *led)
+{
+	int ret;
+
+	ret = pixy2_arbiter_post_led(&arbiters[idx], led);
+	if (ret) {
+		return ret;
+	}
+
+	ret = pixy2_arbiter_flush(&arbiters[idx], K_NO_WAIT);
+	if (ret && ret != -EAGAIN) {
+		return ret;
+	}
+
+	return 0;
+}
+#else
+static int set_led(size_t idx, struct pixy2_led *led)
+{
+	return pixy2_set_led(transports[idx], led);
+}
+#endif /* CONFIG_NXPCUP_PIXY2_ARBITER */
+
+/* all cameras fade at the same time */
+static int interpolate(struct pixy2_led *start, struct pixy2_led *end)
 {
-	float step;
 	int i, ret;
+	size_t j;
 	struct pixy2_led result;
 
 	for (i = 0; i < PIXY2_INTERPOLATION_STEPS; i++) {
-		step = (float) i / PIXY2_INTERPOLATION_STEPS;
+		result.red = start->red +
+			(end->red - start->red) * i / PIXY2_INTERPOLATION_STEPS;
+		result.green = start->green +
+			(end->green - start->green) * i / PIXY2_INTERPOLATION_STEPS;
+		result.blue = start->blue +
+			(end->blue - start->blue) * i / PIXY2_INTERPOLATION_STEPS;
+
+		for (j = 0; j < ARRAY_SIZE(transports); j++) {
+			ret = set_led(j, &result);
+			if (ret) {
+				LOG_ERR("failed to set LED color: %d", ret);
+				return ret;
+			}
+		}
+
+		if (IS_ENABLED(CONFIG_NXPCUP_PIXY2_ARBITER)) {
+			k_sleep(K_MSEC(PIXY2_INTERPOLATION_PERIOD_MS));
+		}
+	}
+
+	return 0;
+}
+
+#ifdef CONFIG_NXPCUP_PIXY2_CAMERA
+#define PIXY2_SPI_CAMERA(idx, _)					\
+	PIXY2_CAMERA(&spi_transports[idx].t, PIXY2_LINE_VECTOR)
+
+/* one camera service per transport, same order as transports[] */
+static struct pixy2_camera cameras[] = {
+#ifdef CONFIG_NXPCUP_PIXY2_I2C_TRANSPORT
+	PIXY2_CAMERA(&i2c_transport.t, PIXY2_LINE_VECTOR),
+#endif /* CONFIG_NXPCUP_PIXY2_I2C_TRANSPORT */
+#ifdef CONFIG_NXPCUP_PIXY2_SPI_TRANSPORT
+	LISTIFY(CONFIG_NXPCUP_PIXY2_SPI_NUM_CAMERAS, PIXY2_SPI_CAMERA, (,)),
+#endif /* CONFIG_NXPCUP_PIXY2_SPI_TRANSPORT */
+};
 
-		result.red = start->red + (end->red - start->red) * step;
-		result.green = start->green + (end->green - start->green) * step;
-		result.blue = start->blue + (end->blue - start->blue) * step;
+static struct pixy2_camera *cams[ARRAY_SIZE(cameras)];
 
-		ret = pixy2_set_led(t, &result);
+static int start_cameras(void)
+{
+	int ret;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(cameras); i++) {
+#ifdef CONFIG_NXPCUP_PIXY2_ARBITER
+		/* the LED demo keeps running next to the camera services */
+		cameras[i].arb = &arbiters[i];
+#endif /* CONFIG_NXPCUP_PIXY2_ARBITER */
+
+		ret = pixy2_camera_start(&cameras[i], PIXY2_CAMERA_THREAD_PRIORITY);
 		if (ret) {
-			LOG_ERR("failed to set LED color: %d", ret);
+			LOG_ERR("failed to start camera service: %d", ret);
 			return ret;
 		}
+
+		cams[i] = &cameras[i];
+	}
+
+	return 0;
+}
+
+static int print_frames(void)
+{
+	int num_frames;
+	size_t i;
+	const struct pixy2_frame *frames[ARRAY_SIZE(cameras)];
+
+	num_frames = pixy2_camera_latest_merged(cams, ARRAY_SIZE(cams),
+						k_us_to_cyc_ceil64(PIXY2_CAMERA_MAX_SKEW_US),
+						frames);
+	if (num_frames < 0) {
+		LOG_ERR("failed to merge frames: %d", num_frames);
+		return num_frames;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(cams); i++) {
+		if (frames[i]) {
+			LOG_INF("camera %zu: frame %u, %u vectors", i,
+				frames[i]->seq, frames[i]->features.num_vectors);
+		}
 	}
 
 	return 0;
 }
+#endif /* CONFIG_NXPCUP_PIXY2_CAMERA */
 
-#if defined(CONFIG_NXPCUP_PIXY2_I2C_TRANSPORT)
-static struct pixy2_i2c_transport transport = {
+#ifdef CONFIG_NXPCUP_PIXY2_BENCHMARK
+#if defined(CONFIG_NXPCUP_PIXY2_I2C_TRANSPORT) && !defined(CONFIG_NXPCUP_PIXY2_RTIO)
+/* the I2C camera is measured in both transaction modes, one transport each */
+static struct pixy2_i2c_transport i2c_separate_transport = {
 	.t.ctlr = DEVICE_DT_GET(DT_NODELABEL(lpi2c3)),
+	.t.name = "i2c separate",
 	.t.api = &pixy2_transport_i2c_api,
-#define PIXY2_I2C_ADDRESS		0x54
 	.address = PIXY2_I2C_ADDRESS,
 };
-#elif defined(CONFIG_NXPCUP_PIXY2_SPI_TRANSPORT)
-static struct pixy2_spi_transport transport = {
-	.t.ctlr = DEVICE_DT_GET(DT_NODELABEL(lpspi3)),
-	.t.api = &pixy2_transport_spi_api,
-#define PIXY2_SPI_SLAVE_INDEX		0x0
-	.sidx = PIXY2_SPI_SLAVE_INDEX,
+
+static struct pixy2_i2c_transport i2c_combined_transport = {
+	.t.ctlr = DEVICE_DT_GET(DT_NODELABEL(lpi2c3)),
+	.t.name = "i2c combined",
+	.t.api = &pixy2_transport_i2c_xfer_api,
+	.address = PIXY2_I2C_ADDRESS,
 };
-#else
-#error "No transport protocol selected"
-#endif
+#endif /* CONFIG_NXPCUP_PIXY2_I2C_TRANSPORT && !CONFIG_NXPCUP_PIXY2_RTIO */
+
+static int benchmark(struct pixy2_transport *t, uint64_t *usec)
+{
+	int i, ret;
+	uint64_t start;
+	struct pixy2_led led = { 0 };
+
+	start = k_cycle_get_64();
+
+	for (i = 0; i < PIXY2_BENCHMARK_ITERATIONS; i++) {
+		ret = pixy2_set_led(t, &led);
+		if (ret) {
+			LOG_ERR("failed to set LED color: %d", ret);
+			return ret;
+		}
+	}
+
+	*usec = MAX(k_cyc_to_us_floor64(k_cycle_get_64() - start), 1);
+
+	LOG_INF("%s: %d messages in %llu us (%llu messages/s)",
+		pixy2_transport_name(t), PIXY2_BENCHMARK_ITERATIONS,
+		(unsigned long long)*usec,
+		(unsigned long long)(PIXY2_BENCHMARK_ITERATIONS *
+				     USEC_PER_SEC / *usec));
+
+	return 0;
+}
+
+static int do_benchmark(struct pixy2_transport *t)
+{
+	uint64_t usec;
+#if defined(CONFIG_NXPCUP_PIXY2_I2C_TRANSPORT) && !defined(CONFIG_NXPCUP_PIXY2_RTIO)
+	int ret;
+	int64_t gain;
+	uint64_t separate, combined;
+
+	if (t == &i2c_transport.t) {
+		ret = benchmark(&i2c_separate_transport.t, &separate);
+		if (ret) {
+			return ret;
+		}
+
+		ret = benchmark(&i2c_combined_transport.t, &combined);
+		if (ret) {
+			return ret;
+		}
+
+		/* messages/s gained by the combined mode, in tenths of a percent */
+		gain = ((int64_t)separate - (int64_t)combined) * 1000 / (int64_t)combined;
+
+		LOG_INF("i2c combined vs separate: %c%lld.%lld%% messages/s",
+			gain < 0 ? '-' : '+', (long long)llabs(gain) / 10,
+			(long long)llabs(gain) % 10);
+
+		return 0;
+	}
+#endif /* CONFIG_NXPCUP_PIXY2_I2C_TRANSPORT && !CONFIG_NXPCUP_PIXY2_RTIO */
+
+	return benchmark(t, &usec);
+}
+#endif /* CONFIG_NXPCUP_PIXY2_BENCHMARK */
 
 int main(void)
 {
 	int ret, i;
+	size_t j;
 	struct pixy2_led *start, *end;
 	struct pixy2_lamp lamp = { .upper = true };
-	struct pixy2_transport *t = &transport.t;
+	struct pixy2_transport *t;
 
-	/* print some information about the camera */
-	ret = pixy2_print_version(t);
-	if (ret) {
-		LOG_ERR("failed to print camera version: %d", ret);
-		return ret;
+	for (j = 0; j < ARRAY_SIZE(transports); j++) {
+		t = transports[j];
+
+		/* the camera may have been left mid-transaction by a previous run */
+		ret = pixy2_transport_recover(t);
+		if (ret) {
+			LOG_ERR("failed to recover camera: %d", ret);
+			return ret;
+		}
+
+#ifdef CONFIG_NXPCUP_PIXY2_CALIBRATION
+		/* go as fast as the wiring allows */
+		ret = pixy2_calibrate_rate(t);
+		if (ret) {
+			LOG_ERR("failed to calibrate bus clock: %d", ret);
+			return ret;
+		}
+#endif /* CONFIG_NXPCUP_PIXY2_CALIBRATION */
+
+		/* print some information about the camera */
+		ret = pixy2_print_version(t);
+		if (ret) {
+			LOG_ERR("failed to print camera version: %d", ret);
+			return ret;
+		}
+
+#ifdef CONFIG_NXPCUP_PIXY2_BENCHMARK
+		ret = do_benchmark(t);
+		if (ret) {
+			LOG_ERR("failed to measure transport throughput: %d", ret);
+			return ret;
+		}
+#endif /* CONFIG_NXPCUP_PIXY2_BENCHMARK */
+
+		/* turn on the two LEDs at the top of the camera */
+		ret = pixy2_set_lamp(t, &lamp);
+		if (ret) {
+			LOG_ERR("failed to toggle upper lamps: %d", ret);
+			return ret;
+		}
+
+#ifdef CONFIG_NXPCUP_PIXY2_ARBITER
+		ret = pixy2_arbiter_init(&arbiters[j], t);
+		if (ret) {
+			LOG_ERR("failed to initialize arbiter: %d", ret);
+			return ret;
+		}
+#endif /* CONFIG_NXPCUP_PIXY2_ARBITER */
 	}
 
-	/* turn on the two LEDs at the top of the camera */
-	ret = pixy2_set_lamp(t, &lamp);
+#ifdef CONFIG_NXPCUP_PIXY2_CAMERA
+	ret = start_cameras();
 	if (ret) {
-		LOG_ERR("failed to toggle upper lamps: %d", ret);
 		return ret;
 	}
 
+#ifndef CONFIG_NXPCUP_PIXY2_ARBITER
+	/* the camera services own the transports from now on */
+	while (true) {
+		ret = print_frames();
+		if (ret) {
+			return ret;
+		}
+
+		k_sleep(K_MSEC(1000));
+	}
+#endif /* CONFIG_NXPCUP_PIXY2_ARBITER */
+#endif /* CONFIG_NXPCUP_PIXY2_CAMERA */
+
 	i = 0;
 
 	/* do cross-fade with the bottom RGB LED */
@@ -106,12 +411,19 @@ int main(void)
 		start = &colors[i];
 		end = &colors[(i + 1) % ARRAY_SIZE(colors)];
 
-		ret = interpolate(t, start, end);
+		ret = interpolate(start, end);
 		if (ret) {
 			LOG_ERR("failed to interpolate: %d", ret);
 			return ret;
 		}
 
+#if defined(CONFIG_NXPCUP_PIXY2_CAMERA) && defined(CONFIG_NXPCUP_PIXY2_ARBITER)
+		ret = print_frames();
+		if (ret) {
+			return ret;
+		}
+#endif /* CONFIG_NXPCUP_PIXY2_CAMERA && CONFIG_NXPCUP_PIXY2_ARBITER */
+
 		i = (i + 1) % ARRAY_SIZE(colors);
 	}
 
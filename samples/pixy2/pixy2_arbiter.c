@@ -0,0 +1,250 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+
+#include <zephyr/logging/log.h>
+
+#include "pixy2_arbiter.h"
+
+LOG_MODULE_REGISTER(pixy2_arbiter);
+
+/* priority at which each slot is flushed */
+static const uint8_t pixy2_arbiter_slot_prio[PIXY2_ARBITER_NUM_SLOTS] = {
+	[PIXY2_ARBITER_SLOT_MODE] = PIXY2_ARBITER_CONTROL,
+	[PIXY2_ARBITER_SLOT_VECTOR] = PIXY2_ARBITER_CONTROL,
+	[PIXY2_ARBITER_SLOT_NEXT_TURN] = PIXY2_ARBITER_CONTROL,
+	[PIXY2_ARBITER_SLOT_DEFAULT_TURN] = PIXY2_ARBITER_CONTROL,
+	[PIXY2_ARBITER_SLOT_LED] = PIXY2_ARBITER_STATUS,
+	[PIXY2_ARBITER_SLOT_LAMP] = PIXY2_ARBITER_STATUS,
+};
+
+int pixy2_arbiter_init(struct pixy2_arbiter *arb, struct pixy2_transport *t)
+{
+	/* sanity checks */
+	if (!arb || !t) {
+		return -EINVAL;
+	}
+
+	memset(arb, 0, sizeof(*arb));
+
+	arb->t = t;
+
+	k_mutex_init(&arb->lock);
+	k_condvar_init(&arb->released);
+
+	return 0;
+}
+
+/* true if a client of higher priority than prio is waiting */
+static bool pixy2_arbiter_preempted(struct pixy2_arbiter *arb,
+				    enum pixy2_arbiter_prio prio)
+{
+	enum pixy2_arbiter_prio i;
+
+	for (i = 0; i < prio; i++) {
+		if (arb->waiting[i]) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int pixy2_arbiter_acquire(struct pixy2_arbiter *arb,
+			  enum pixy2_arbiter_prio prio, k_timeout_t timeout)
+{
+	int ret = 0;
+	k_timepoint_t end;
+
+	/* sanity checks */
+	if (!arb || prio >= PIXY2_ARBITER_NUM_PRIOS) {
+		return -EINVAL;
+	}
+
+	end = sys_timepoint_calc(timeout);
+
+	k_mutex_lock(&arb->lock, K_FOREVER);
+
+	arb->waiting[prio]++;
+
+	while (arb->busy || pixy2_arbiter_preempted(arb, prio)) {
+		ret = k_condvar_wait(&arb->released, &arb->lock,
+				     sys_timepoint_timeout(end));
+		if (ret) {
+			ret = -EAGAIN;
+			break;
+		}
+	}
+
+	arb->waiting[prio]--;
+
+	if (!ret) {
+		arb->busy = true;
+	} else {
+		/* lower priority clients may have been waiting on us */
+		k_condvar_broadcast(&arb->released);
+	}
+
+	k_mutex_unlock(&arb->lock);
+
+	return ret;
+}
+
+void pixy2_arbiter_release(struct pixy2_arbiter *arb)
+{
+	k_mutex_lock(&arb->lock, K_FOREVER);
+
+	arb->busy = false;
+
+	/* the waiters sort out among themselves who goes next */
+	k_condvar_broadcast(&arb->released);
+
+	k_mutex_unlock(&arb->lock);
+}
+
+static int pixy2_arbiter_post(struct pixy2_arbiter *arb,
+			      enum pixy2_arbiter_slot slot,
+			      size_t offset, const void *value, size_t len)
+{
+	/* sanity checks */
+	if (!arb || !value) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&arb->lock, K_FOREVER);
+
+	memcpy((uint8_t *)&arb->values + offset, value, len);
+	arb->pending |= BIT(slot);
+
+	k_mutex_unlock(&arb->lock);
+
+	return 0;
+}
+
+#define pixy2_arbiter_post_value(arb, slot, field, value)		\
+	pixy2_arbiter_post(arb, slot,					\
+			   offsetof(struct pixy2_arbiter_values, field),	\
+			   value, sizeof(((struct pixy2_arbiter_values *)0)->field))
+
+int pixy2_arbiter_post_led(struct pixy2_arbiter *arb,
+			   const struct pixy2_led *led)
+{
+	return pixy2_arbiter_post_value(arb, PIXY2_ARBITER_SLOT_LED, led, led);
+}
+
+int pixy2_arbiter_post_lamp(struct pixy2_arbiter *arb,
+			    const struct pixy2_lamp *lamp)
+{
+	return pixy2_arbiter_post_value(arb, PIXY2_ARBITER_SLOT_LAMP, lamp, lamp);
+}
+
+int pixy2_arbiter_post_mode(struct pixy2_arbiter *arb, uint8_t mode)
+{
+	return pixy2_arbiter_post_value(arb, PIXY2_ARBITER_SLOT_MODE, mode, &mode);
+}
+
+int pixy2_arbiter_post_vector(struct pixy2_arbiter *arb, uint8_t index)
+{
+	return pixy2_arbiter_post_value(arb, PIXY2_ARBITER_SLOT_VECTOR,
+					vector, &index);
+}
+
+int pixy2_arbiter_post_next_turn(struct pixy2_arbiter *arb, int16_t angle)
+{
+	return pixy2_arbiter_post_value(arb, PIXY2_ARBITER_SLOT_NEXT_TURN,
+					next_turn, &angle);
+}
+
+int pixy2_arbiter_post_default_turn(struct pixy2_arbiter *arb, int16_t angle)
+{
+	return pixy2_arbiter_post_value(arb, PIXY2_ARBITER_SLOT_DEFAULT_TURN,
+					default_turn, &angle);
+}
+
+static int pixy2_arbiter_send(struct pixy2_transport *t,
+			      enum pixy2_arbiter_slot slot,
+			      struct pixy2_arbiter_values *v)
+{
+	switch (slot) {
+	case PIXY2_ARBITER_SLOT_MODE:
+		return pixy2_set_mode(t, v->mode);
+	case PIXY2_ARBITER_SLOT_VECTOR:
+		return pixy2_set_vector(t, v->vector);
+	case PIXY2_ARBITER_SLOT_NEXT_TURN:
+		return pixy2_set_next_turn(t, v->next_turn);
+	case PIXY2_ARBITER_SLOT_DEFAULT_TURN:
+		return pixy2_set_default_turn(t, v->default_turn);
+	case PIXY2_ARBITER_SLOT_LED:
+		return pixy2_set_led(t, &v->led);
+	case PIXY2_ARBITER_SLOT_LAMP:
+		return pixy2_set_lamp(t, &v->lamp);
+	default:
+		return -EINVAL;
+	}
+
+	CODE_UNREACHABLE;
+}
+
+int pixy2_arbiter_flush(struct pixy2_arbiter *arb, k_timeout_t timeout)
+{
+	int ret, slot;
+	uint32_t pending, posted;
+	struct pixy2_arbiter_values values;
+
+	/* sanity checks */
+	if (!arb) {
+		return -EINVAL;
+	}
+
+	/* values posted from now on go out with the next flush */
+	k_mutex_lock(&arb->lock, K_FOREVER);
+	pending = arb->pending;
+	k_mutex_unlock(&arb->lock);
+
+	for (slot = 0; slot < PIXY2_ARBITER_NUM_SLOTS; slot++) {
+		if (!(pending & BIT(slot))) {
+			continue;
+		}
+
+		ret = pixy2_arbiter_acquire(arb, pixy2_arbiter_slot_prio[slot],
+					    timeout);
+		if (ret) {
+			return ret;
+		}
+
+		/* take the latest value, posting again will post a new one */
+		k_mutex_lock(&arb->lock, K_FOREVER);
+
+		values = arb->values;
+		posted = arb->pending & BIT(slot);
+		arb->pending &= ~BIT(slot);
+
+		k_mutex_unlock(&arb->lock);
+
+		/* another thread may have flushed it in the meantime */
+		ret = posted ? pixy2_arbiter_send(arb->t, slot, &values) : 0;
+
+		if (ret) {
+			/*
+			 * keep the value posted for the next flush. If a newer
+			 * one was posted in the meantime, it's already there.
+			 */
+			k_mutex_lock(&arb->lock, K_FOREVER);
+			arb->pending |= BIT(slot);
+			k_mutex_unlock(&arb->lock);
+		}
+
+		pixy2_arbiter_release(arb);
+
+		if (ret) {
+			LOG_ERR("failed to send posted command: %d", ret);
+			return ret;
+		}
+	}
+
+	return 0;
+}
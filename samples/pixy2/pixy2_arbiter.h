@@ -0,0 +1,233 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file pixy2_arbiter.h
+ * @brief Pixy2 bus arbiter API
+ *
+ * This file offers an API for sharing one camera between several clients
+ * (e.g. the control loop fetching frames and a thread driving the status
+ * LED). Each client acquires the camera at a given priority for a single
+ * transaction. When the camera is released, it goes to the waiting client
+ * of highest priority, such that a frame request waits for at most one
+ * lower priority transaction.
+ *
+ * Setter commands whose effect only depends on their last value (e.g.
+ * setLED(), setMode()) are not sent right away. Instead, their value is
+ * posted into a slot and sent on the next flush. Posting again before the
+ * flush overwrites the value, so only the latest one goes over the bus.
+ */
+
+#ifndef _PIXY2_ARBITER_H_
+#define _PIXY2_ARBITER_H_
+
+#include <zephyr/kernel.h>
+
+#include "pixy2_command.h"
+
+/**
+ * @enum pixy2_arbiter_prio
+ * @brief Pixy2 arbiter client priorities, highest first
+ */
+enum pixy2_arbiter_prio {
+	/** frame acquisition (e.g. getMainFeatures()) */
+	PIXY2_ARBITER_FRAME,
+	/** tracking control (e.g. setMode(), setNextTurn()) */
+	PIXY2_ARBITER_CONTROL,
+	/** status indication (e.g. setLED(), setLamp()) */
+	PIXY2_ARBITER_STATUS,
+	PIXY2_ARBITER_NUM_PRIOS,
+};
+
+/**
+ * @enum pixy2_arbiter_slot
+ * @brief Pixy2 arbiter coalescing slots, flushed in this order
+ */
+enum pixy2_arbiter_slot {
+	PIXY2_ARBITER_SLOT_MODE,
+	PIXY2_ARBITER_SLOT_VECTOR,
+	PIXY2_ARBITER_SLOT_NEXT_TURN,
+	PIXY2_ARBITER_SLOT_DEFAULT_TURN,
+	PIXY2_ARBITER_SLOT_LED,
+	PIXY2_ARBITER_SLOT_LAMP,
+	PIXY2_ARBITER_NUM_SLOTS,
+};
+
+/**
+ * @struct pixy2_arbiter_values
+ * @brief Latest values posted to the coalescing slots
+ */
+struct pixy2_arbiter_values {
+	/** setMode() argument */
+	uint8_t mode;
+	/** setVector() argument */
+	uint8_t vector;
+	/** setNextTurn() argument */
+	int16_t next_turn;
+	/** setDefaultTurn() argument */
+	int16_t default_turn;
+	/** setLED() argument */
+	struct pixy2_led led;
+	/** setLamp() argument */
+	struct pixy2_lamp lamp;
+};
+
+/**
+ * @struct pixy2_arbiter
+ * @brief Pixy2 bus arbiter
+ */
+struct pixy2_arbiter {
+	/** transport used for talking to the camera */
+	struct pixy2_transport *t;
+	/** protects the fields below */
+	struct k_mutex lock;
+	/** signalled whenever the camera is released */
+	struct k_condvar released;
+	/** true while a client holds the camera */
+	bool busy;
+	/** number of waiting clients, per priority */
+	uint8_t waiting[PIXY2_ARBITER_NUM_PRIOS];
+	/** bitmask of slots holding a value not sent yet */
+	uint32_t pending;
+	/** latest posted values */
+	struct pixy2_arbiter_values values;
+};
+
+/**
+ * @brief Initialize an arbiter
+ *
+ * @param arb pointer to the arbiter
+ * @param t pointer to the generic transport layer data
+ *
+ * @retval 0 if success
+ * @retval negative errno code if error
+ */
+int pixy2_arbiter_init(struct pixy2_arbiter *arb, struct pixy2_transport *t);
+
+/**
+ * @brief Acquire the camera for a single transaction
+ *
+ * On success, the caller may use @ref pixy2_arbiter::t until it calls
+ * @ref pixy2_arbiter_release. The camera is only granted if no client of
+ * higher priority is waiting.
+ *
+ * @param arb pointer to the arbiter
+ * @param prio client priority
+ * @param timeout how long to wait for the camera
+ *
+ * @retval 0 if success
+ * @retval -EAGAIN if the camera couldn't be acquired in time
+ * @retval negative errno code if error
+ */
+int pixy2_arbiter_acquire(struct pixy2_arbiter *arb,
+			  enum pixy2_arbiter_prio prio, k_timeout_t timeout);
+
+/**
+ * @brief Release the camera
+ *
+ * @param arb pointer to the arbiter
+ */
+void pixy2_arbiter_release(struct pixy2_arbiter *arb);
+
+/**
+ * @brief Post a setLED() command
+ *
+ * Never blocks on the camera. Overwrites the value posted since the last
+ * flush, if any.
+ *
+ * @param arb pointer to the arbiter
+ * @param led LED color
+ *
+ * @retval 0 if success
+ * @retval negative errno code if error
+ */
+int pixy2_arbiter_post_led(struct pixy2_arbiter *arb,
+			   const struct pixy2_led *led);
+
+/**
+ * @brief Post a setLamp() command
+ *
+ * See @ref pixy2_arbiter_post_led.
+ *
+ * @param arb pointer to the arbiter
+ * @param lamp lamp state
+ *
+ * @retval 0 if success
+ * @retval negative errno code if error
+ */
+int pixy2_arbiter_post_lamp(struct pixy2_arbiter *arb,
+			    const struct pixy2_lamp *lamp);
+
+/**
+ * @brief Post a setMode() command
+ *
+ * See @ref pixy2_arbiter_post_led.
+ *
+ * @param arb pointer to the arbiter
+ * @param mode bitmask of line tracking modes - see @ref Pixy2LineModes
+ *
+ * @retval 0 if success
+ * @retval negative errno code if error
+ */
+int pixy2_arbiter_post_mode(struct pixy2_arbiter *arb, uint8_t mode);
+
+/**
+ * @brief Post a setVector() command
+ *
+ * See @ref pixy2_arbiter_post_led.
+ *
+ * @param arb pointer to the arbiter
+ * @param index tracking index of the vector
+ *
+ * @retval 0 if success
+ * @retval negative errno code if error
+ */
+int pixy2_arbiter_post_vector(struct pixy2_arbiter *arb, uint8_t index);
+
+/**
+ * @brief Post a setNextTurn() command
+ *
+ * See @ref pixy2_arbiter_post_led.
+ *
+ * @param arb pointer to the arbiter
+ * @param angle turn angle (in degrees)
+ *
+ * @retval 0 if success
+ * @retval negative errno code if error
+ */
+int pixy2_arbiter_post_next_turn(struct pixy2_arbiter *arb, int16_t angle);
+
+/**
+ * @brief Post a setDefaultTurn() command
+ *
+ * See @ref pixy2_arbiter_post_led.
+ *
+ * @param arb pointer to the arbiter
+ * @param angle turn angle (in degrees)
+ *
+ * @retval 0 if success
+ * @retval negative errno code if error
+ */
+int pixy2_arbiter_post_default_turn(struct pixy2_arbiter *arb, int16_t angle);
+
+/**
+ * @brief Send the posted commands
+ *
+ * Each posted command is sent as a separate transaction, tracking control
+ * commands first, at the priority matching the command. Commands that
+ * could not be sent (e.g. @p timeout expired, transfer failed) remain
+ * posted, unless a newer value is posted for them in the meantime.
+ *
+ * @param arb pointer to the arbiter
+ * @param timeout how long to wait for the camera, for each command
+ *
+ * @retval 0 if success
+ * @retval -EAGAIN if the camera couldn't be acquired in time
+ * @retval negative errno code if error
+ */
+int pixy2_arbiter_flush(struct pixy2_arbiter *arb, k_timeout_t timeout);
+
+#endif /* _PIXY2_ARBITER_H_ */
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+
+#include <zephyr/logging/log.h>
+
+#include "pixy2_calibration.h"
+#include "pixy2_command.h"
+
+LOG_MODULE_REGISTER(pixy2_calibration);
+
+/*
+ * talk to the transport layer directly: the protocol layer would recover
+ * the camera and retry, hiding the very errors we're looking for.
+ */
+static int pixy2_calibration_get_version(struct pixy2_transport *t,
+					 uint8_t *buf)
+{
+	int ret;
+	struct pixy2_message req = PIXY2_COMMAND_REQUEST(GET_VERSION, NULL, PIXY2_CHECKSUM);
+	struct pixy2_message reply = PIXY2_COMMAND_REPLY(GET_VERSION, buf, PIXY2_CHECKSUM);
+
+	/* the request has no payload, so its checksum is 0 */
+	reply.hdr.type = PIXY2_REPLY_GET_VERSION;
+	reply.min_len = PIXY2_REPLY_MIN_LEN_GET_VERSION;
+
+	ret = pixy2_transport_transceive(t, &req, &reply);
+	if (ret) {
+		return ret;
+	}
+
+	/* the transport layer lets error replies through */
+	if (reply.hdr.type != PIXY2_REPLY_GET_VERSION) {
+		return -EBADMSG;
+	}
+
+	return pixy2_protocol_check_payload(&reply);
+}
+
+/* run the workload at the current rate, stop at the first error */
+static int pixy2_calibration_check(struct pixy2_transport *t,
+				   const uint8_t *ref)
+{
+	int ret, i;
+	uint8_t buf[PIXY2_REPLY_MAX_LEN_GET_VERSION];
+
+	for (i = 0; i < CONFIG_NXPCUP_PIXY2_CALIBRATION_ITERATIONS; i++) {
+		memset(buf, 0, sizeof(buf));
+
+		ret = pixy2_calibration_get_version(t, buf);
+		if (ret) {
+			return ret;
+		}
+
+		if (memcmp(buf, ref, sizeof(buf))) {
+			return -EIO;
+		}
+	}
+
+	return 0;
+}
+
+int pixy2_calibrate_rate(struct pixy2_transport *t)
+{
+	int ret, best;
+	size_t i;
+	const struct pixy2_transport_api *api;
+	uint8_t ref[PIXY2_REPLY_MAX_LEN_GET_VERSION];
+
+	/* sanity checks */
+	if (!t || !t->api) {
+		return -EINVAL;
+	}
+
+	api = t->api;
+
+	if (!api->set_rate || !api->num_rates) {
+		return -ENOTSUP;
+	}
+
+	/* the reference reply is read at the slowest rate */
+	ret = pixy2_transport_set_rate(t, api->rates[0]);
+	if (ret) {
+		LOG_ERR("failed to set rate: %d", ret);
+		return ret;
+	}
+
+	ret = pixy2_calibration_get_version(t, ref);
+	if (ret) {
+		LOG_ERR("failed to get reference reply: %d", ret);
+		return ret;
+	}
+
+	best = -1;
+
+	for (i = 0; i < api->num_rates; i++) {
+		ret = pixy2_transport_set_rate(t, api->rates[i]);
+		if (ret) {
+			LOG_ERR("failed to set rate: %d", ret);
+			return ret;
+		}
+
+		ret = pixy2_calibration_check(t, ref);
+		if (ret) {
+			LOG_INF("%s: %u Hz failed: %d", pixy2_transport_name(t),
+				api->rates[i], ret);
+			break;
+		}
+
+		best = i;
+	}
+
+	/* the camera may have been left out of sync by the failed rate */
+	if (ret) {
+		ret = pixy2_transport_set_rate(t, api->rates[0]);
+		if (ret) {
+			LOG_ERR("failed to set rate: %d", ret);
+			return ret;
+		}
+
+		ret = pixy2_transport_recover(t);
+		if (ret) {
+			LOG_ERR("failed to recover camera: %d", ret);
+			return ret;
+		}
+	}
+
+	if (best < 0) {
+		LOG_ERR("no error-free rate found");
+		return -EIO;
+	}
+
+	ret = pixy2_transport_set_rate(t,
+				       api->rates[MAX(best - CONFIG_NXPCUP_PIXY2_CALIBRATION_MARGIN, 0)]);
+	if (ret) {
+		LOG_ERR("failed to set rate: %d", ret);
+		return ret;
+	}
+
+	LOG_INF("%s: using %u Hz (fastest error-free: %u Hz)", pixy2_transport_name(t),
+		t->rate, api->rates[best]);
+
+	return 0;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file pixy2_calibration.h
+ * @brief Pixy2 bus clock calibration API
+ *
+ * This file offers an API for finding the fastest bus clock rate at which
+ * a given camera can be talked to reliably. The wiring and harness length
+ * differ from car to car, so the best rate is found at startup instead of
+ * being hardcoded.
+ *
+ * The rates offered by the transport (see @ref pixy2_transport_api::rates)
+ * are tried in increasing order. At each rate, a number of getVersion()
+ * requests are sent and their replies compared to a reference reply read
+ * at the slowest rate. With CONFIG_NXPCUP_PIXY2_CHECKSUM, the replies are
+ * also checked against their checksum. The first rate producing a single
+ * error ends the search. The rate finally used is the fastest error-free
+ * one, minus a safety margin.
+ */
+
+#ifndef _PIXY2_CALIBRATION_H_
+#define _PIXY2_CALIBRATION_H_
+
+#include "pixy2_transport.h"
+
+/**
+ * @brief Calibrate the bus clock rate
+ *
+ * Must be called before the transport is handed to anyone else (e.g. a
+ * camera service). On success, the selected rate is stored in
+ * @ref pixy2_transport::rate.
+ *
+ * @param t pointer to the generic transport layer data
+ *
+ * @retval 0 if success
+ * @retval -ENOTSUP if the transport doesn't support changing the rate
+ * @retval -EIO if not even the slowest rate is error-free
+ * @retval negative errno code if error
+ */
+int pixy2_calibrate_rate(struct pixy2_transport *t);
+
+#endif /* _PIXY2_CALIBRATION_H_ */
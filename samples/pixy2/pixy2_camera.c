@@ -0,0 +1,160 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+
+#include "pixy2_camera.h"
+
+LOG_MODULE_REGISTER(pixy2_camera);
+
+/* set in pixy2_camera::middle if the frame wasn't consumed yet */
+#define PIXY2_CAMERA_FRESH	BIT(7)
+#define PIXY2_CAMERA_IDX_MASK	BIT_MASK(2)
+
+/* how long to back off when the camera has no new frame */
+#define PIXY2_CAMERA_BUSY_SLEEP_US	500
+/* how long to back off after an error */
+#define PIXY2_CAMERA_ERROR_SLEEP_MS	10
+
+static void pixy2_camera_publish(struct pixy2_camera *cam)
+{
+	atomic_val_t old;
+
+	old = atomic_set(&cam->middle, cam->back | PIXY2_CAMERA_FRESH);
+
+	cam->back = old & PIXY2_CAMERA_IDX_MASK;
+}
+
+static void pixy2_camera_thread(void *p1, void *p2, void *p3)
+{
+	int ret;
+	struct pixy2_frame *frame;
+	struct pixy2_camera *cam = p1;
+
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	while (true) {
+		frame = &cam->frames[cam->back];
+
+#ifdef CONFIG_NXPCUP_PIXY2_ARBITER
+		if (cam->arb) {
+			ret = pixy2_arbiter_acquire(cam->arb, PIXY2_ARBITER_FRAME,
+						    K_FOREVER);
+			if (ret) {
+				LOG_ERR("failed to acquire camera: %d", ret);
+				k_sleep(K_MSEC(PIXY2_CAMERA_ERROR_SLEEP_MS));
+				continue;
+			}
+		}
+#endif /* CONFIG_NXPCUP_PIXY2_ARBITER */
+
+		ret = pixy2_get_main_features(cam->t, cam->features,
+					      &frame->features);
+
+#ifdef CONFIG_NXPCUP_PIXY2_ARBITER
+		if (cam->arb) {
+			pixy2_arbiter_release(cam->arb);
+		}
+#endif /* CONFIG_NXPCUP_PIXY2_ARBITER */
+		if (ret == -EBUSY) {
+			/* no new frame yet */
+			k_sleep(K_USEC(PIXY2_CAMERA_BUSY_SLEEP_US));
+			continue;
+		}
+
+		if (ret) {
+			LOG_ERR("failed to get features: %d", ret);
+			k_sleep(K_MSEC(PIXY2_CAMERA_ERROR_SLEEP_MS));
+			continue;
+		}
+
+		frame->timestamp = k_cycle_get_64();
+		frame->seq = ++cam->seq;
+
+		pixy2_camera_publish(cam);
+	}
+}
+
+int pixy2_camera_start(struct pixy2_camera *cam, int prio)
+{
+#ifdef CONFIG_THREAD_NAME
+	char name[CONFIG_THREAD_MAX_NAME_LEN];
+#endif /* CONFIG_THREAD_NAME */
+
+	/* sanity checks */
+	if (!cam || !cam->t) {
+		return -EINVAL;
+	}
+
+	k_thread_create(&cam->thread, cam->stack,
+			K_KERNEL_STACK_SIZEOF(cam->stack),
+			pixy2_camera_thread, cam, NULL, NULL,
+			prio, 0, K_NO_WAIT);
+
+#ifdef CONFIG_THREAD_NAME
+	/* tell the cameras apart, the same way as their statistics */
+	snprintk(name, sizeof(name), "pixy2_camera_%s",
+		 pixy2_transport_name(cam->t));
+	k_thread_name_set(&cam->thread, name);
+#endif /* CONFIG_THREAD_NAME */
+
+	return 0;
+}
+
+const struct pixy2_frame *pixy2_camera_latest(struct pixy2_camera *cam)
+{
+	atomic_val_t old;
+
+	if (atomic_get(&cam->middle) & PIXY2_CAMERA_FRESH) {
+		old = atomic_set(&cam->middle, cam->front);
+		cam->front = old & PIXY2_CAMERA_IDX_MASK;
+	}
+
+	/* nothing published yet */
+	if (!cam->frames[cam->front].seq) {
+		return NULL;
+	}
+
+	return &cam->frames[cam->front];
+}
+
+int pixy2_camera_latest_merged(struct pixy2_camera *const *cams, size_t num,
+			       uint64_t max_skew,
+			       const struct pixy2_frame **frames)
+{
+	size_t i;
+	int kept = 0;
+	uint64_t newest = 0;
+
+	/* sanity checks */
+	if (!cams || !frames || !num) {
+		return -EINVAL;
+	}
+
+	for (i = 0; i < num; i++) {
+		frames[i] = pixy2_camera_latest(cams[i]);
+		if (frames[i]) {
+			newest = MAX(newest, frames[i]->timestamp);
+		}
+	}
+
+	for (i = 0; i < num; i++) {
+		if (!frames[i]) {
+			continue;
+		}
+
+		/* too old to describe the same moment as the newest frame */
+		if (newest - frames[i]->timestamp > max_skew) {
+			frames[i] = NULL;
+			continue;
+		}
+
+		kept++;
+	}
+
+	return kept;
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file pixy2_camera.h
+ * @brief Pixy2 camera service API
+ *
+ * This file offers an API for acquiring line tracking frames from a
+ * dedicated thread. The thread owns the transport and publishes each
+ * received frame into a lock-free single-producer/single-consumer
+ * mailbox with latest-value-wins semantics: the consumer always gets the
+ * freshest frame in constant time, without blocking and without having
+ * to go through stale frames first.
+ *
+ * The mailbox is a triple buffer. The producer fills the back frame and
+ * atomically swaps it with the middle one. The consumer atomically swaps
+ * the middle frame with the front one, but only if the producer has
+ * published something new since. Frames are never copied.
+ */
+
+#ifndef _PIXY2_CAMERA_H_
+#define _PIXY2_CAMERA_H_
+
+#include <zephyr/kernel.h>
+
+#include "pixy2_command.h"
+
+#ifdef CONFIG_NXPCUP_PIXY2_ARBITER
+#include "pixy2_arbiter.h"
+#endif /* CONFIG_NXPCUP_PIXY2_ARBITER */
+
+/** number of frames making up the mailbox */
+#define PIXY2_CAMERA_NUM_FRAMES 3
+
+/**
+ * @struct pixy2_frame
+ * @brief Frame published by the camera service
+ */
+struct pixy2_frame {
+	/** line tracking features */
+	struct pixy2_features features;
+	/** sequence number, starting from 1 */
+	uint32_t seq;
+	/** time at which the frame was received (in hardware cycles) */
+	uint64_t timestamp;
+};
+
+/**
+ * @struct pixy2_camera
+ * @brief Pixy2 camera service
+ */
+struct pixy2_camera {
+	/** transport used for talking to the camera, owned by the thread */
+	struct pixy2_transport *t;
+#ifdef CONFIG_NXPCUP_PIXY2_ARBITER
+	/**
+	 * arbiter sharing the camera with other clients, if any. The frames
+	 * are then requested at the highest priority.
+	 */
+	struct pixy2_arbiter *arb;
+#endif /* CONFIG_NXPCUP_PIXY2_ARBITER */
+	/** bitmask of requested features - see @ref Pixy2LineFeatures */
+	uint8_t features;
+	/** mailbox frames */
+	struct pixy2_frame frames[PIXY2_CAMERA_NUM_FRAMES];
+	/** index of the frame being filled (producer only) */
+	uint8_t back;
+	/** index of the frame read by the consumer (consumer only) */
+	uint8_t front;
+	/** index of the latest published frame, with the "fresh" bit */
+	atomic_t middle;
+	/** sequence number of the last published frame */
+	uint32_t seq;
+	/** acquisition thread */
+	struct k_thread thread;
+	/** acquisition thread stack */
+	K_KERNEL_STACK_MEMBER(stack, CONFIG_NXPCUP_PIXY2_CAMERA_STACK_SIZE);
+};
+
+/**
+ * @brief Prepare a pixy2_camera structure
+ *
+ * @param transport pointer to the generic transport layer data
+ * @param f bitmask of requested features - see @ref Pixy2LineFeatures
+ */
+#define PIXY2_CAMERA(transport, f)	\
+{					\
+	.t = transport,			\
+	.features = f,			\
+	.back = 0,			\
+	.front = 1,			\
+	.middle = ATOMIC_INIT(2),	\
+}
+
+/**
+ * @brief Start the acquisition thread
+ *
+ * From this point on, the transport belongs to the camera service and
+ * should not be used by anyone else, unless shared through
+ * @ref pixy2_camera::arb.
+ *
+ * The thread is named after the transport (see pixy2_transport_name()).
+ *
+ * @param cam pointer to the camera service
+ * @param prio priority of the acquisition thread
+ *
+ * @retval 0 if success
+ * @retval negative errno code if error
+ */
+int pixy2_camera_start(struct pixy2_camera *cam, int prio);
+
+/**
+ * @brief Get the latest frame
+ *
+ * Never blocks. The returned frame remains valid until the next call.
+ * If no new frame was published since the previous call, the same frame
+ * is returned again (compare @ref pixy2_frame::seq to find out).
+ *
+ * Must only be called from one thread.
+ *
+ * @param cam pointer to the camera service
+ *
+ * @retval pointer to the latest frame
+ * @retval NULL if no frame was published yet
+ */
+const struct pixy2_frame *pixy2_camera_latest(struct pixy2_camera *cam);
+
+/**
+ * @brief Get the latest frames of several cameras, merged by timestamp
+ *
+ * Used when more than one camera looks at the track (e.g. a near-field
+ * and a far-field one). The cameras are acquired in parallel, each from
+ * its own thread, so their latest frames are not taken at the same time.
+ * The newest of them is used as reference and the frames taken more than
+ * @p max_skew cycles before it are dropped (i.e. set to NULL), such that
+ * the remaining frames describe the same moment.
+ *
+ * Same as @ref pixy2_camera_latest, must only be called from one thread.
+ *
+ * @param cams array of camera services
+ * @param num number of camera services
+ * @param max_skew maximum age of a frame relative to the newest one (in cycles)
+ * @param frames array of @p num entries filled with the frame of each camera
+ *
+ * @retval number of frames kept
+ * @retval -EINVAL if the arguments are invalid
+ */
+int pixy2_camera_latest_merged(struct pixy2_camera *const *cams, size_t num,
+			       uint64_t max_skew,
+			       const struct pixy2_frame **frames);
+
+#endif /* _PIXY2_CAMERA_H_ */
@@ -0,0 +1,232 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "pixy2_centerline.h"
+
+/* column of the camera's axis */
+#define PIXY2_CENTERLINE_AXIS	((PIXY2_LINE_GRID_WIDTH - 1) / 2)
+
+/* number of rows the centerline is sampled at: near, middle and far */
+#define PIXY2_CENTERLINE_NUM_ROWS 3
+
+/* atan(z) ~= 45 * z + 15.642 * z * (1 - |z|) degrees, for |z| <= 1 */
+#define PIXY2_ATAN_K0		45000
+#define PIXY2_ATAN_K1		15642
+#define PIXY2_ATAN_Q		15
+
+int32_t pixy2_atan_mdeg(int32_t y, int32_t x)
+{
+	int64_t z, abs_z;
+	int32_t angle;
+
+	/* |y / x| > 1 - use atan(y / x) = +/-(90 - atan(x / |y|)) */
+	if (y > x || y < -x) {
+		angle = 90000 - pixy2_atan_mdeg(x, y < 0 ? -y : y);
+
+		return y < 0 ? -angle : angle;
+	}
+
+	/* y may be negative, multiply instead of shifting */
+	z = (int64_t)y * (1 << PIXY2_ATAN_Q) / x;
+	abs_z = z < 0 ? -z : z;
+
+	return (PIXY2_ATAN_K0 * z +
+		((PIXY2_ATAN_K1 * z * ((1 << PIXY2_ATAN_Q) - abs_z)) >> PIXY2_ATAN_Q))
+		>> PIXY2_ATAN_Q;
+}
+
+static uint32_t isqrt64(uint64_t x)
+{
+	uint64_t res, bit;
+
+	res = 0;
+	bit = 1ULL << 62;
+
+	while (bit > x) {
+		bit >>= 2;
+	}
+
+	while (bit) {
+		if (x >= res + bit) {
+			x -= res + bit;
+			res = (res >> 1) + bit;
+		} else {
+			res >>= 1;
+		}
+
+		bit >>= 2;
+	}
+
+	return res;
+}
+
+/* x coordinate of the line going through a vector at a given row */
+static int32_t vector_x_at(const struct pixy2_vector *v, int32_t row)
+{
+	int32_t x_near, y_near, x_far, y_far;
+
+	/* orient the vector from the near (bottom) end to the far end */
+	if (v->y0 > v->y1) {
+		x_near = v->x0;
+		y_near = v->y0;
+		x_far = v->x1;
+		y_far = v->y1;
+	} else {
+		x_near = v->x1;
+		y_near = v->y1;
+		x_far = v->x0;
+		y_far = v->y0;
+	}
+
+	return PIXY2_CENTERLINE_FIXED(x_near) +
+		PIXY2_CENTERLINE_FIXED((x_far - x_near) * (y_near - row)) /
+		(y_near - y_far);
+}
+
+/*
+ * find the x coordinate of a boundary at a given row. The innermost of the
+ * vectors spanning the row wins. If there's no such vector, extrapolate the
+ * one ending closest to the row.
+ */
+static bool boundary_x_at(const struct pixy2_features *f, bool left,
+			  int32_t row, int32_t *x)
+{
+	int i;
+	bool found, spanned;
+	int32_t y_min, y_max, dist, best_dist, vx;
+	const struct pixy2_vector *v;
+
+	found = false;
+	spanned = false;
+	best_dist = INT32_MAX;
+
+	for (i = 0; i < f->num_vectors; i++) {
+		v = &f->vectors[i];
+
+		/* horizontal vectors carry no boundary information */
+		if (v->y0 == v->y1 || (v->flags & PIXY2_LINE_FLAG_INVALID)) {
+			continue;
+		}
+
+		/* vectors are assigned to a side based on their midpoint */
+		if ((v->x0 + v->x1 < 2 * PIXY2_CENTERLINE_AXIS) != left) {
+			continue;
+		}
+
+		y_min = MIN(v->y0, v->y1);
+		y_max = MAX(v->y0, v->y1);
+
+		vx = vector_x_at(v, row);
+
+		if (row >= y_min && row <= y_max) {
+			if (!spanned || (left ? vx > *x : vx < *x)) {
+				*x = vx;
+			}
+
+			spanned = true;
+			found = true;
+			continue;
+		}
+
+		if (spanned) {
+			continue;
+		}
+
+		dist = row < y_min ? y_min - row : row - y_max;
+		if (dist < best_dist) {
+			best_dist = dist;
+			*x = vx;
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+int pixy2_centerline_estimate(const struct pixy2_centerline_config *cfg,
+			      const struct pixy2_features *f,
+			      struct pixy2_centerline *c)
+{
+	int i;
+	bool has_left, has_right;
+	int32_t rows[PIXY2_CENTERLINE_NUM_ROWS];
+	int32_t u[PIXY2_CENTERLINE_NUM_ROWS], x[PIXY2_CENTERLINE_NUM_ROWS];
+	int32_t left_x, right_x, half_width;
+	int64_t cross, a, b, d;
+
+	/* sanity checks */
+	if (!cfg || !f || !c || cfg->far_row >= cfg->near_row ||
+	    cfg->near_row >= PIXY2_LINE_GRID_HEIGHT) {
+		return -EINVAL;
+	}
+
+	rows[0] = cfg->near_row;
+	rows[1] = (cfg->near_row + cfg->far_row) / 2;
+	rows[2] = cfg->far_row;
+
+	c->sides = 0;
+
+	for (i = 0; i < PIXY2_CENTERLINE_NUM_ROWS; i++) {
+		has_left = boundary_x_at(f, true, rows[i], &left_x);
+		has_right = boundary_x_at(f, false, rows[i], &right_x);
+
+		/* perspective: the track narrows linearly towards the far row */
+		half_width = cfg->near_half_width +
+			(cfg->far_half_width - cfg->near_half_width) *
+			(cfg->near_row - rows[i]) / (cfg->near_row - cfg->far_row);
+
+		if (has_left && has_right) {
+			x[i] = (left_x + right_x) / 2;
+		} else if (has_left) {
+			x[i] = left_x + half_width;
+		} else if (has_right) {
+			x[i] = right_x - half_width;
+		} else {
+			return -ENODATA;
+		}
+
+		/* distance ahead of the near row */
+		u[i] = PIXY2_CENTERLINE_FIXED(cfg->near_row - rows[i]);
+
+		c->sides |= (has_left ? PIXY2_CENTERLINE_LEFT : 0) |
+			(has_right ? PIXY2_CENTERLINE_RIGHT : 0);
+	}
+
+	c->offset = x[0] - PIXY2_CENTERLINE_FIXED(PIXY2_CENTERLINE_AXIS);
+	c->heading = pixy2_atan_mdeg(x[2] - x[0], u[2] - u[0]);
+
+	/*
+	 * Menger curvature of the three sample points: 2 * sin(angle) over
+	 * the length of the opposite side, i.e. 2 * cross / (|a| * |b| * |d|).
+	 * The sign is flipped so that bending right is positive.
+	 */
+	cross = (int64_t)(x[1] - x[0]) * (u[2] - u[0]) -
+		(int64_t)(u[1] - u[0]) * (x[2] - x[0]);
+
+	a = isqrt64((int64_t)(x[1] - x[0]) * (x[1] - x[0]) +
+		    (int64_t)(u[1] - u[0]) * (u[1] - u[0]));
+	b = isqrt64((int64_t)(x[2] - x[1]) * (x[2] - x[1]) +
+		    (int64_t)(u[2] - u[1]) * (u[2] - u[1]));
+	d = isqrt64((int64_t)(x[2] - x[0]) * (x[2] - x[0]) +
+		    (int64_t)(u[2] - u[0]) * (u[2] - u[0]));
+
+	if (!a || !b || !d) {
+		c->curvature = 0;
+		return 0;
+	}
+
+	/*
+	 * cross has 2 * Q fractional bits and a * b * d 3 * Q, so scaling
+	 * by 2^(Q + CURVATURE_Q) leaves CURVATURE_Q fractional bits. The
+	 * scale is signed, otherwise a negative cross turns the whole
+	 * division unsigned.
+	 */
+	c->curvature = -(2 * cross *
+			 ((int64_t)1 << (PIXY2_CENTERLINE_Q + PIXY2_CENTERLINE_CURVATURE_Q))) /
+		(a * b * d);
+
+	return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file pixy2_centerline.h
+ * @brief Track centerline estimation API
+ *
+ * This file offers the API for turning the line vectors reported by the
+ * getMainFeatures() command into an estimate of the track's centerline,
+ * expressed as lateral offset, heading error and curvature.
+ *
+ * Vectors are split into left and right track boundaries. The centerline
+ * is sampled at three rows of the 79x52 line tracking grid (near, middle
+ * and far) as the midpoint between the two boundaries or, if only one of
+ * them is visible, by offsetting it by half the track width. The track
+ * width is modelled as changing linearly between the near and far rows
+ * to account for perspective.
+ *
+ * Only integer arithmetic is used and the amount of work is bounded by the
+ * maximum number of vectors fitting in a reply, so the estimation takes a
+ * deterministic amount of time.
+ */
+
+#ifndef _PIXY2_CENTERLINE_H_
+#define _PIXY2_CENTERLINE_H_
+
+#include "pixy2_command.h"
+
+/** width of the line tracking grid */
+#define PIXY2_LINE_GRID_WIDTH		79
+/** height of the line tracking grid */
+#define PIXY2_LINE_GRID_HEIGHT		52
+
+/** number of fractional bits used for grid coordinates */
+#define PIXY2_CENTERLINE_Q		8
+/** convert grid units (possibly negative) to fixed-point grid units */
+#define PIXY2_CENTERLINE_FIXED(x)	((x) * (1 << PIXY2_CENTERLINE_Q))
+
+/** number of fractional bits used for the curvature */
+#define PIXY2_CENTERLINE_CURVATURE_Q	16
+
+/**
+ * @defgroup CenterlineSides
+ * @brief Track boundaries used for the estimation
+ *
+ * @{
+ */
+
+/** left boundary was visible */
+#define PIXY2_CENTERLINE_LEFT		BIT(0)
+/** right boundary was visible */
+#define PIXY2_CENTERLINE_RIGHT		BIT(1)
+
+/**
+ * @}
+ */
+
+/**
+ * @struct pixy2_centerline_config
+ * @brief Centerline estimation parameters
+ */
+struct pixy2_centerline_config {
+	/** row of the near sample point (typically the bottom row) */
+	uint8_t near_row;
+	/** row of the far (look-ahead) sample point, above the near row */
+	uint8_t far_row;
+	/** half of the track width at the near row (fixed-point grid units) */
+	int32_t near_half_width;
+	/** half of the track width at the far row (fixed-point grid units) */
+	int32_t far_half_width;
+};
+
+/**
+ * @struct pixy2_centerline
+ * @brief Centerline estimate
+ *
+ * Positive values mean the centerline is to the right of/bends to the
+ * right of the camera's axis.
+ */
+struct pixy2_centerline {
+	/** lateral offset at the near row (fixed-point grid units) */
+	int32_t offset;
+	/** heading error between the near and far rows (millidegrees) */
+	int32_t heading;
+	/** curvature (1 / grid units, #PIXY2_CENTERLINE_CURVATURE_Q fixed-point) */
+	int32_t curvature;
+	/** boundaries used for the estimation - see @ref CenterlineSides */
+	uint8_t sides;
+};
+
+/**
+ * @brief Estimate the track's centerline
+ *
+ * @param cfg pointer to the estimation parameters
+ * @param f pointer to the line tracking features
+ * @param c pointer to the structure receiving the estimate
+ *
+ * @retval 0 if success
+ * @retval -EINVAL if the parameters are invalid
+ * @retval -ENODATA if no usable vector was found
+ */
+int pixy2_centerline_estimate(const struct pixy2_centerline_config *cfg,
+			      const struct pixy2_features *f,
+			      struct pixy2_centerline *c);
+
+/**
+ * @brief Compute the arctangent of y / x
+ *
+ * Integer approximation with a maximum error of about 0.25 degrees.
+ *
+ * @param y ordinate
+ * @param x abscissa, must be positive
+ *
+ * @retval angle in millidegrees, in the (-90000, 90000) interval
+ */
+int32_t pixy2_atan_mdeg(int32_t y, int32_t x);
+
+#endif /* _PIXY2_CENTERLINE_H_ */
@@ -21,11 +21,50 @@ struct pixy2_version {
 	char fw_type[PIXY2_VERSION_FW_TYPE_MAX_BYTES];
 } __packed;
 
+/* getMainFeatures() request type: main features only */
+#define PIXY2_LINE_GET_MAIN_FEATURES 0x0
+
+/* needs to be packed */
+struct pixy2_blocks_args {
+	uint8_t sigmap;
+	uint8_t max_blocks;
+} __packed;
+
+/* header of each feature found in the getMainFeatures() reply */
+struct pixy2_feature_header {
+	uint8_t type;
+	uint8_t len;
+} __packed;
+
+/* the command table has to agree with the command arguments/replies */
+BUILD_ASSERT(sizeof(struct pixy2_version) == PIXY2_REPLY_MIN_LEN_GET_VERSION);
+BUILD_ASSERT(sizeof(struct pixy2_version) == PIXY2_REPLY_MAX_LEN_GET_VERSION);
+BUILD_ASSERT(sizeof(struct pixy2_led) == PIXY2_REQUEST_LEN_SET_LED);
+BUILD_ASSERT(sizeof(struct pixy2_lamp) == PIXY2_REQUEST_LEN_SET_LAMP);
+BUILD_ASSERT(sizeof(struct pixy2_features_args) ==
+	     PIXY2_REQUEST_LEN_GET_MAIN_FEATURES);
+BUILD_ASSERT(sizeof(struct pixy2_blocks_args) == PIXY2_REQUEST_LEN_GET_BLOCKS);
+BUILD_ASSERT(sizeof(uint8_t) == PIXY2_REQUEST_LEN_SET_MODE);
+BUILD_ASSERT(sizeof(uint8_t) == PIXY2_REQUEST_LEN_SET_VECTOR);
+BUILD_ASSERT(sizeof(int16_t) == PIXY2_REQUEST_LEN_SET_NEXT_TURN);
+BUILD_ASSERT(sizeof(int16_t) == PIXY2_REQUEST_LEN_SET_DEFAULT_TURN);
+BUILD_ASSERT(PIXY2_REQUEST_LEN_REVERSE_VECTOR == 0);
+BUILD_ASSERT(sizeof(int32_t) == PIXY2_REPLY_MAX_LEN_SET_LED &&
+	     sizeof(int32_t) == PIXY2_REPLY_MAX_LEN_SET_LAMP &&
+	     sizeof(int32_t) == PIXY2_REPLY_MAX_LEN_SET_MODE &&
+	     sizeof(int32_t) == PIXY2_REPLY_MAX_LEN_SET_VECTOR &&
+	     sizeof(int32_t) == PIXY2_REPLY_MAX_LEN_SET_NEXT_TURN &&
+	     sizeof(int32_t) == PIXY2_REPLY_MAX_LEN_SET_DEFAULT_TURN &&
+	     sizeof(int32_t) == PIXY2_REPLY_MAX_LEN_REVERSE_VECTOR);
+BUILD_ASSERT(sizeof(((struct pixy2_features *)0)->buf) ==
+	     PIXY2_REPLY_MAX_LEN_GET_MAIN_FEATURES);
+BUILD_ASSERT(sizeof(((struct pixy2_blocks *)0)->buf) ==
+	     PIXY2_REPLY_MAX_LEN_GET_BLOCKS);
+
 static int pixy2_get_version(struct pixy2_transport *t, struct pixy2_version *v)
 {
-	struct pixy2_message req = PIXY2_REQUEST(PIXY2_REQUEST_GET_VERSION,
-						 0x0, NULL, false);
-	struct pixy2_message reply = PIXY2_REPLY(sizeof(*v), v, false);
+	struct pixy2_message req = PIXY2_COMMAND_REQUEST(GET_VERSION, NULL, PIXY2_CHECKSUM);
+	struct pixy2_message reply = PIXY2_COMMAND_REPLY(GET_VERSION, v, PIXY2_CHECKSUM);
 
 	return pixy2_protocol_transceive(t, &req, &reply);
 }
@@ -52,9 +91,8 @@ int pixy2_set_led(struct pixy2_transport *t, struct pixy2_led *led)
 {
 	int ret;
 	int32_t result;
-	struct pixy2_message req = PIXY2_REQUEST(PIXY2_REQUEST_SET_LED,
-						 sizeof(*led), led, false);
-	struct pixy2_message reply = PIXY2_REPLY(sizeof(result), &result, false);
+	struct pixy2_message req = PIXY2_COMMAND_REQUEST(SET_LED, led, PIXY2_CHECKSUM);
+	struct pixy2_message reply = PIXY2_COMMAND_REPLY(SET_LED, &result, PIXY2_CHECKSUM);
 
 	ret = pixy2_protocol_transceive(t, &req, &reply);
 	if (ret) {
@@ -69,9 +107,8 @@ int pixy2_set_lamp(struct pixy2_transport *t, struct pixy2_lamp *lamp)
 {
 	int ret;
 	int32_t result;
-	struct pixy2_message req = PIXY2_REQUEST(PIXY2_REQUEST_SET_LAMP,
-						 sizeof(*lamp), lamp, false);
-	struct pixy2_message reply = PIXY2_REPLY(sizeof(result), &result, false);
+	struct pixy2_message req = PIXY2_COMMAND_REQUEST(SET_LAMP, lamp, PIXY2_CHECKSUM);
+	struct pixy2_message reply = PIXY2_COMMAND_REPLY(SET_LAMP, &result, PIXY2_CHECKSUM);
 
 	ret = pixy2_protocol_transceive(t, &req, &reply);
 	if (ret) {
@@ -81,3 +118,222 @@ int pixy2_set_lamp(struct pixy2_transport *t, struct pixy2_lamp *lamp)
 
 	return pixy2_to_errno(result);
 }
+
+int pixy2_parse_features(struct pixy2_features *f, uint8_t len)
+{
+	struct pixy2_feature_header *fhdr;
+	const uint8_t *data;
+	uint8_t offset;
+
+	f->num_vectors = 0;
+	f->num_intersections = 0;
+	f->num_barcodes = 0;
+
+	offset = 0;
+
+	while (offset < len) {
+		if (offset + sizeof(*fhdr) > len) {
+			return -EINVAL;
+		}
+
+		fhdr = (struct pixy2_feature_header *)&f->buf[offset];
+		data = &f->buf[offset + sizeof(*fhdr)];
+
+		offset += sizeof(*fhdr);
+
+		if (fhdr->len > len - offset) {
+			return -EINVAL;
+		}
+
+		offset += fhdr->len;
+
+		switch (fhdr->type) {
+		case PIXY2_LINE_VECTOR:
+			f->vectors = (const struct pixy2_vector *)data;
+			f->num_vectors = fhdr->len / sizeof(*f->vectors);
+			break;
+		case PIXY2_LINE_INTERSECTION:
+			f->intersections = (const struct pixy2_intersection *)data;
+			f->num_intersections = fhdr->len / sizeof(*f->intersections);
+			break;
+		case PIXY2_LINE_BARCODE:
+			f->barcodes = (const struct pixy2_barcode *)data;
+			f->num_barcodes = fhdr->len / sizeof(*f->barcodes);
+			break;
+		default:
+			/* unknown feature, skip it */
+			break;
+		}
+	}
+
+	return 0;
+}
+
+int pixy2_get_main_features(struct pixy2_transport *t, uint8_t features,
+			    struct pixy2_features *f)
+{
+	int ret;
+	struct pixy2_features_args args = {
+		.type = PIXY2_LINE_GET_MAIN_FEATURES,
+		.features = features,
+	};
+	struct pixy2_message req = PIXY2_COMMAND_REQUEST(GET_MAIN_FEATURES,
+							 &args, PIXY2_CHECKSUM);
+	struct pixy2_message reply = PIXY2_COMMAND_REPLY(GET_MAIN_FEATURES,
+							 f->buf, PIXY2_CHECKSUM);
+
+	/*
+	 * this is called once per frame so keep it quiet: -EBUSY (i.e. no
+	 * new frame) is expected and errors are left to the caller to report.
+	 */
+	ret = pixy2_protocol_transceive(t, &req, &reply);
+	if (ret) {
+		return ret;
+	}
+
+	return pixy2_parse_features(f, reply.hdr.len);
+}
+
+/* send a command whose reply is a single status code */
+#define pixy2_send_command(t, name, args)				\
+	pixy2_send_result_command(t, PIXY2_REQUEST_##name,		\
+				  PIXY2_REQUEST_LEN_##name, args)
+
+static int pixy2_send_result_command(struct pixy2_transport *t, uint8_t type,
+				     uint8_t len, const void *args)
+{
+	int ret;
+	int32_t result;
+	struct pixy2_message req = PIXY2_REQUEST(type, len, args, PIXY2_CHECKSUM);
+	struct pixy2_message reply = PIXY2_REPLY(sizeof(result), &result, PIXY2_CHECKSUM);
+
+	ret = pixy2_protocol_transceive(t, &req, &reply);
+	if (ret) {
+		return ret;
+	}
+
+	return pixy2_to_errno(result);
+}
+
+int pixy2_set_mode(struct pixy2_transport *t, uint8_t mode)
+{
+	int ret;
+
+	ret = pixy2_send_command(t, SET_MODE, &mode);
+	if (ret) {
+		LOG_ERR("failed to send setMode command: %d", ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+int pixy2_set_next_turn(struct pixy2_transport *t, int16_t angle)
+{
+	int ret;
+
+	ret = pixy2_send_command(t, SET_NEXT_TURN, &angle);
+	if (ret) {
+		LOG_ERR("failed to send setNextTurn command: %d", ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+int pixy2_set_default_turn(struct pixy2_transport *t, int16_t angle)
+{
+	int ret;
+
+	ret = pixy2_send_command(t, SET_DEFAULT_TURN, &angle);
+	if (ret) {
+		LOG_ERR("failed to send setDefaultTurn command: %d", ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+int pixy2_set_vector(struct pixy2_transport *t, uint8_t index)
+{
+	int ret;
+
+	ret = pixy2_send_command(t, SET_VECTOR, &index);
+	if (ret) {
+		LOG_ERR("failed to send setVector command: %d", ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+int pixy2_reverse_vector(struct pixy2_transport *t)
+{
+	int ret;
+
+	ret = pixy2_send_command(t, REVERSE_VECTOR, NULL);
+	if (ret) {
+		LOG_ERR("failed to send reverseVector command: %d", ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+int pixy2_get_blocks(struct pixy2_transport *t, uint8_t sigmap,
+		     uint8_t max_blocks, struct pixy2_blocks *b)
+{
+	int ret;
+	struct pixy2_blocks_args args = {
+		.sigmap = sigmap,
+		.max_blocks = max_blocks,
+	};
+	struct pixy2_message req = PIXY2_COMMAND_REQUEST(GET_BLOCKS, &args, PIXY2_CHECKSUM);
+	struct pixy2_message reply = PIXY2_COMMAND_REPLY(GET_BLOCKS, b->buf, PIXY2_CHECKSUM);
+
+	/* same as getMainFeatures(), errors are left to the caller */
+	ret = pixy2_protocol_transceive(t, &req, &reply);
+	if (ret) {
+		return ret;
+	}
+
+	if (reply.hdr.len % sizeof(*b->blocks)) {
+		return -EINVAL;
+	}
+
+	b->blocks = (const struct pixy2_block *)b->buf;
+	b->num_blocks = reply.hdr.len / sizeof(*b->blocks);
+
+	return 0;
+}
+
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+int pixy2_submit_main_features(struct pixy2_transport *t,
+			       struct pixy2_features_xfer *x,
+			       uint8_t features, struct pixy2_features *f)
+{
+	x->args.type = PIXY2_LINE_GET_MAIN_FEATURES;
+	x->args.features = features;
+	x->f = f;
+
+	x->req = (struct pixy2_message)PIXY2_COMMAND_REQUEST(GET_MAIN_FEATURES,
+							     &x->args, PIXY2_CHECKSUM);
+	x->reply = (struct pixy2_message)PIXY2_COMMAND_REPLY(GET_MAIN_FEATURES,
+							     f->buf, PIXY2_CHECKSUM);
+
+	return pixy2_protocol_submit(t, &x->req, &x->reply);
+}
+
+int pixy2_complete_main_features(struct pixy2_transport *t,
+				 struct pixy2_features_xfer *x, bool wait)
+{
+	int ret;
+
+	ret = pixy2_protocol_complete(t, &x->req, &x->reply, wait);
+	if (ret) {
+		return ret;
+	}
+
+	return pixy2_parse_features(x->f, x->reply.hdr.len);
+}
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
@@ -19,13 +19,16 @@
 
 #include "pixy2_protocol.h"
 
+/** true if the commands are sent with checksum verification enabled */
+#define PIXY2_CHECKSUM IS_ENABLED(CONFIG_NXPCUP_PIXY2_CHECKSUM)
+
 /**
  * @brief Prepare a Pixy2 request message
  *
  * Use this to create a @ref pixy2_message structure
  * required for sending a request to the Pixy2 camera.
  *
- * @param t request type - one of @ref Pixy2RequestTypes
+ * @param t request type - one of @ref pixy2_request_type
  * @param l request payload length
  * @param p pointer to payload data
  * @param c boolean indicating if checksum should be performed or not
@@ -59,10 +62,41 @@
 	.hdr.sync0 = PIXY2_REPLY_SYNC0,		\
 	.hdr.sync1 = PIXY2_REPLY_SYNC1,		\
 	.hdr.len = l,				\
-	.hdr.checksum = c,			\
+	.checksum = c,				\
 	.payload = (uint8_t *)p,		\
 }
 
+/**
+ * @brief Prepare the request message of a command
+ *
+ * Same as @ref PIXY2_REQUEST but the type and payload length are taken
+ * from the command table (see @ref PIXY2_COMMANDS).
+ *
+ * @param name command name, as found in the command table (e.g. SET_LED)
+ * @param p pointer to payload data
+ * @param c boolean indicating if checksum should be performed or not
+ *
+ * @retval newly created @ref pixy2_message structure
+ */
+#define PIXY2_COMMAND_REQUEST(name, p, c)			\
+	PIXY2_REQUEST(PIXY2_REQUEST_##name,			\
+		      PIXY2_REQUEST_LEN_##name, p, c)
+
+/**
+ * @brief Prepare the reply message of a command
+ *
+ * Same as @ref PIXY2_REPLY but the payload length is the command's
+ * maximum reply length (see @ref PIXY2_COMMANDS).
+ *
+ * @param name command name, as found in the command table (e.g. SET_LED)
+ * @param p address to use for storing the payload data
+ * @param c boolean indicating if checksum should be performed or not
+ *
+ * @retval newly created @ref pixy2_message structure
+ */
+#define PIXY2_COMMAND_REPLY(name, p, c)				\
+	PIXY2_REPLY(PIXY2_REPLY_MAX_LEN_##name, p, c)
+
 /**
  * @struct pixy2_led
  * @brief Pixy2 setLED() command arguments
@@ -87,6 +121,248 @@ struct pixy2_lamp {
 	uint8_t lower;
 } __packed;
 
+/**
+ * @defgroup Pixy2LineFeatures
+ * @brief Pixy2 line tracking features
+ *
+ * Feature types used both as bits in the bitmask passed to
+ * @ref pixy2_get_main_features and as type field of the features
+ * found in the getMainFeatures() reply.
+ *
+ * @{
+ */
+
+/** line vectors */
+#define PIXY2_LINE_VECTOR			BIT(0)
+/** line intersections */
+#define PIXY2_LINE_INTERSECTION			BIT(1)
+/** barcodes */
+#define PIXY2_LINE_BARCODE			BIT(2)
+/** all of the above */
+#define PIXY2_LINE_ALL_FEATURES			(PIXY2_LINE_VECTOR |	\
+						 PIXY2_LINE_INTERSECTION |\
+						 PIXY2_LINE_BARCODE)
+
+/**
+ * @}
+ */
+
+/**
+ * @defgroup Pixy2LineModes
+ * @brief Pixy2 line tracking modes
+ *
+ * Bits of the mode passed to @ref pixy2_set_mode.
+ *
+ * @{
+ */
+
+/** wait for @ref pixy2_set_next_turn before taking an intersection */
+#define PIXY2_LINE_MODE_TURN_DELAYED		BIT(0)
+/** only use the vector selected via @ref pixy2_set_vector */
+#define PIXY2_LINE_MODE_MANUAL_SELECT_VECTOR	BIT(1)
+/** look for light lines on a dark background */
+#define PIXY2_LINE_MODE_WHITE_LINE		BIT(7)
+
+/**
+ * @}
+ */
+
+/** vector flag: vector is no longer tracked */
+#define PIXY2_LINE_FLAG_INVALID			BIT(1)
+/** vector flag: there's an intersection at the end of the vector */
+#define PIXY2_LINE_FLAG_INTERSECTION_PRESENT	BIT(2)
+
+/** maximum number of lines (branches) making up an intersection */
+#define PIXY2_LINE_MAX_INTERSECTION_LINES	6
+
+/**
+ * @struct pixy2_vector
+ * @brief Pixy2 line vector
+ *
+ * Coordinates are expressed in the 79x52 line tracking grid, with the
+ * vector pointing from (x0, y0) (tail) to (x1, y1) (head).
+ */
+struct pixy2_vector {
+	/** x coordinate of the tail */
+	uint8_t x0;
+	/** y coordinate of the tail */
+	uint8_t y0;
+	/** x coordinate of the head */
+	uint8_t x1;
+	/** y coordinate of the head */
+	uint8_t y1;
+	/** tracking index */
+	uint8_t index;
+	/** vector flags - see PIXY2_LINE_FLAG_* */
+	uint8_t flags;
+} __packed;
+
+/**
+ * @struct pixy2_intersection_line
+ * @brief Branch of a Pixy2 line intersection
+ */
+struct pixy2_intersection_line {
+	/** tracking index of the line */
+	uint8_t index;
+	/** reserved */
+	uint8_t reserved;
+	/** angle of the line (in degrees) */
+	int16_t angle;
+} __packed;
+
+/**
+ * @struct pixy2_intersection
+ * @brief Pixy2 line intersection
+ */
+struct pixy2_intersection {
+	/** x coordinate of the intersection */
+	uint8_t x;
+	/** y coordinate of the intersection */
+	uint8_t y;
+	/** number of valid entries in @ref pixy2_intersection::lines */
+	uint8_t n;
+	/** reserved */
+	uint8_t reserved;
+	/** lines making up the intersection */
+	struct pixy2_intersection_line lines[PIXY2_LINE_MAX_INTERSECTION_LINES];
+} __packed;
+
+/**
+ * @struct pixy2_barcode
+ * @brief Pixy2 barcode
+ */
+struct pixy2_barcode {
+	/** x coordinate of the barcode */
+	uint8_t x;
+	/** y coordinate of the barcode */
+	uint8_t y;
+	/** barcode flags */
+	uint8_t flags;
+	/** barcode value */
+	int8_t code;
+} __packed;
+
+/**
+ * @struct pixy2_features
+ * @brief Result of the getMainFeatures() command
+ *
+ * The feature arrays are views over @ref pixy2_features::buf, which holds
+ * the raw reply payload. Nothing is copied out of the payload, meaning the
+ * views are only valid for as long as the buffer is left untouched (i.e.
+ * until the structure is passed to @ref pixy2_get_main_features again).
+ */
+struct pixy2_features {
+	/** raw reply payload */
+	uint8_t buf[PIXY2_MAX_PAYLOAD_LEN];
+	/** line vectors */
+	const struct pixy2_vector *vectors;
+	/** number of line vectors */
+	uint8_t num_vectors;
+	/** line intersections */
+	const struct pixy2_intersection *intersections;
+	/** number of line intersections */
+	uint8_t num_intersections;
+	/** barcodes */
+	const struct pixy2_barcode *barcodes;
+	/** number of barcodes */
+	uint8_t num_barcodes;
+};
+
+/**
+ * @defgroup Pixy2Signatures
+ * @brief Pixy2 color signatures
+ *
+ * Bits of the signature bitmask passed to @ref pixy2_get_blocks.
+ *
+ * @{
+ */
+
+/** color signature N (1 - 7) */
+#define PIXY2_SIGNATURE(n)			BIT((n) - 1)
+/** color codes */
+#define PIXY2_SIGNATURE_COLOR_CODES		BIT(7)
+/** all signatures and color codes */
+#define PIXY2_SIGNATURE_ALL			0xff
+
+/**
+ * @}
+ */
+
+/**
+ * @struct pixy2_block
+ * @brief Pixy2 color connected component (block)
+ *
+ * Coordinates and sizes are expressed in pixels (316x208 frame).
+ */
+struct pixy2_block {
+	/** color signature (1 - 7) or color code */
+	uint16_t signature;
+	/** x coordinate of the center */
+	uint16_t x;
+	/** y coordinate of the center */
+	uint16_t y;
+	/** width */
+	uint16_t width;
+	/** height */
+	uint16_t height;
+	/** angle of color code blocks (in degrees), 0 otherwise */
+	int16_t angle;
+	/** tracking index */
+	uint8_t index;
+	/** number of frames the block has been tracked for (saturates at 255) */
+	uint8_t age;
+} __packed;
+
+/** maximum number of blocks fitting in a getBlocks() reply */
+#define PIXY2_MAX_BLOCKS	(PIXY2_MAX_PAYLOAD_LEN / sizeof(struct pixy2_block))
+
+/**
+ * @struct pixy2_blocks
+ * @brief Result of the getBlocks() command
+ *
+ * Fixed-capacity arena holding at most #PIXY2_MAX_BLOCKS blocks. As with
+ * @ref pixy2_features, the blocks are a view over the raw reply payload.
+ */
+struct pixy2_blocks {
+	/** raw reply payload */
+	uint8_t buf[PIXY2_MAX_PAYLOAD_LEN];
+	/** blocks */
+	const struct pixy2_block *blocks;
+	/** number of blocks */
+	uint8_t num_blocks;
+};
+
+/**
+ * @struct pixy2_features_args
+ * @brief Pixy2 getMainFeatures() command arguments
+ */
+struct pixy2_features_args {
+	/** request type - main features (0) or all features (1) */
+	uint8_t type;
+	/** bitmask of requested features - see @ref Pixy2LineFeatures */
+	uint8_t features;
+} __packed;
+
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+/**
+ * @struct pixy2_features_xfer
+ * @brief In-flight getMainFeatures() command
+ *
+ * Holds the data that needs to outlive @ref pixy2_submit_main_features,
+ * up until the matching @ref pixy2_complete_main_features.
+ */
+struct pixy2_features_xfer {
+	/** request message */
+	struct pixy2_message req;
+	/** reply message */
+	struct pixy2_message reply;
+	/** request arguments */
+	struct pixy2_features_args args;
+	/** structure receiving the features */
+	struct pixy2_features *f;
+};
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
+
 /**
  * @brief Print firmware and hardware information
  *
@@ -125,4 +401,170 @@ int pixy2_set_led(struct pixy2_transport *t, struct pixy2_led *led);
  */
 int pixy2_set_lamp(struct pixy2_transport *t, struct pixy2_lamp *lamp);
 
+/**
+ * @brief Send the getMainFeatures command
+ *
+ * Use this to query the features detected by the line tracking algorithm
+ * (via the getMainFeatures() command). The reply payload is received
+ * directly into @p f and parsed in place.
+ *
+ * If the camera has no new frame since the previous call, -EBUSY is
+ * returned and the content of @p f should be treated as invalid.
+ *
+ * @param t pointer to the generic transport layer data
+ * @param features bitmask of requested features - see @ref Pixy2LineFeatures
+ * @param f pointer to the structure receiving the features
+ *
+ * @retval 0 if success
+ * @retval -EBUSY if no new data is available
+ * @retval negative errno code if error
+ */
+int pixy2_get_main_features(struct pixy2_transport *t, uint8_t features,
+			    struct pixy2_features *f);
+
+/**
+ * @brief Send the getBlocks command
+ *
+ * Use this to query the blocks detected by the color connected components
+ * algorithm (via the getBlocks() command). The reply payload is received
+ * directly into @p b.
+ *
+ * If the camera has no new frame since the previous call, -EBUSY is
+ * returned and the content of @p b should be treated as invalid.
+ *
+ * @param t pointer to the generic transport layer data
+ * @param sigmap bitmask of requested signatures - see @ref Pixy2Signatures
+ * @param max_blocks maximum number of blocks to return
+ * @param b pointer to the structure receiving the blocks
+ *
+ * @retval 0 if success
+ * @retval -EBUSY if no new data is available
+ * @retval negative errno code if error
+ */
+int pixy2_get_blocks(struct pixy2_transport *t, uint8_t sigmap,
+		     uint8_t max_blocks, struct pixy2_blocks *b);
+
+/**
+ * @brief Send the setMode command
+ *
+ * Use this to configure the line tracking algorithm (via the setMode()
+ * command).
+ *
+ * @param t pointer to the generic transport layer data
+ * @param mode line tracking mode - see @ref Pixy2LineModes
+ *
+ * @retval 0 if success
+ * @retval negative errno code if error
+ */
+int pixy2_set_mode(struct pixy2_transport *t, uint8_t mode);
+
+/**
+ * @brief Send the setNextTurn command
+ *
+ * Use this to select the branch taken at the next intersection (via the
+ * setNextTurn() command).
+ *
+ * @param t pointer to the generic transport layer data
+ * @param angle angle of the branch (in degrees, 0 is straight ahead,
+ * positive is left)
+ *
+ * @retval 0 if success
+ * @retval negative errno code if error
+ */
+int pixy2_set_next_turn(struct pixy2_transport *t, int16_t angle);
+
+/**
+ * @brief Send the setDefaultTurn command
+ *
+ * Use this to select the branch taken at intersections when no
+ * setNextTurn() command was issued (via the setDefaultTurn() command).
+ *
+ * @param t pointer to the generic transport layer data
+ * @param angle angle of the branch (in degrees, 0 is straight ahead,
+ * positive is left)
+ *
+ * @retval 0 if success
+ * @retval negative errno code if error
+ */
+int pixy2_set_default_turn(struct pixy2_transport *t, int16_t angle);
+
+/**
+ * @brief Send the setVector command
+ *
+ * Use this to select the vector the camera should follow when
+ * #PIXY2_LINE_MODE_MANUAL_SELECT_VECTOR is set (via the setVector() command).
+ *
+ * @param t pointer to the generic transport layer data
+ * @param index tracking index of the vector
+ *
+ * @retval 0 if success
+ * @retval negative errno code if error
+ */
+int pixy2_set_vector(struct pixy2_transport *t, uint8_t index);
+
+/**
+ * @brief Send the reverseVector command
+ *
+ * Use this to invert the head and tail of the tracked vector (via the
+ * reverseVector() command).
+ *
+ * @param t pointer to the generic transport layer data
+ *
+ * @retval 0 if success
+ * @retval negative errno code if error
+ */
+int pixy2_reverse_vector(struct pixy2_transport *t);
+
+/**
+ * @brief Parse the payload of a getMainFeatures() reply in place
+ *
+ * Point the feature arrays of @p f to the features found in
+ * @ref pixy2_features::buf. Used internally by the getMainFeatures()
+ * helpers, exposed for the code receiving the reply on its own.
+ *
+ * @param f pointer to the structure holding the reply payload
+ * @param len length of the reply payload
+ *
+ * @retval 0 if success
+ * @retval -EINVAL if the payload is malformed
+ */
+int pixy2_parse_features(struct pixy2_features *f, uint8_t len);
+
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+/**
+ * @brief Submit the getMainFeatures command
+ *
+ * Asynchronous counterpart of @ref pixy2_get_main_features. Returns as
+ * soon as the request is queued. @p x and @p f are owned by the transport
+ * until @ref pixy2_complete_main_features returns something other than
+ * -EAGAIN.
+ *
+ * @param t pointer to the generic transport layer data
+ * @param x pointer to the in-flight command data
+ * @param features bitmask of requested features - see @ref Pixy2LineFeatures
+ * @param f pointer to the structure receiving the features
+ *
+ * @retval 0 if success
+ * @retval negative errno code if error
+ */
+int pixy2_submit_main_features(struct pixy2_transport *t,
+			       struct pixy2_features_xfer *x,
+			       uint8_t features, struct pixy2_features *f);
+
+/**
+ * @brief Complete a submitted getMainFeatures command
+ *
+ * @param t pointer to the generic transport layer data
+ * @param x pointer to the in-flight command data
+ * @param wait true if the call should block until the reply is received
+ *
+ * @retval 0 if success
+ * @retval -EAGAIN if @p wait is false and the reply is not received yet
+ * @retval -EBUSY if no new data is available
+ * @retval negative errno code if error
+ */
+int pixy2_complete_main_features(struct pixy2_transport *t,
+				 struct pixy2_features_xfer *x, bool wait);
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
+
 #endif /* _PIXY2_COMMAND_H_ */
@@ -0,0 +1,670 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Pixy2 camera emulator
+ *
+ * Answers the requests issued by the transport layer with scripted content,
+ * which allows exercising and benchmarking the I2C and SPI transports on
+ * native_sim. Each feature request gets a new frame in which the track
+ * boundaries and the blocks sway from left to right. The line tracking
+ * settings (mode, selected vector, turns) are kept and shape the frames
+ * the same way a camera would, tests may read them back through
+ * pixy2_emul_get_line().
+ */
+
+#define DT_DRV_COMPAT nxp_pixy2_emul
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/i2c_emul.h>
+#include <zephyr/drivers/spi.h>
+#include <zephyr/drivers/spi_emul.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "pixy2_command.h"
+#include "pixy2_emul.h"
+#include "pixy2_protocol.h"
+
+LOG_MODULE_REGISTER(pixy2_emul);
+
+/* longest SPI transfer the emulator accepts, i.e. the recovery flush */
+#define PIXY2_EMUL_MAX_XFER_LEN	PIXY2_FLUSH_LEN
+
+/* number of frames it takes the scripted content to sway across the grid */
+#define PIXY2_EMUL_SWAY_FRAMES	32
+
+/* value clocked out when the camera has nothing to say, same as a camera */
+#define PIXY2_EMUL_IDLE_BYTE	PIXY2_SPI_IDLE_BYTE
+
+/* reply type of the commands answering with a result code */
+#define PIXY2_EMUL_REPLY_RESULT	0x1
+
+/* length of the firmware type string in the getVersion() reply */
+#define PIXY2_EMUL_FW_TYPE_LEN	10
+
+/* number of vectors in a frame, i.e. the two track boundaries */
+#define PIXY2_EMUL_NUM_VECTORS	2
+
+/* line tracking modes known to the camera */
+#define PIXY2_EMUL_LINE_MODES	(PIXY2_LINE_MODE_TURN_DELAYED |		\
+				 PIXY2_LINE_MODE_MANUAL_SELECT_VECTOR |	\
+				 PIXY2_LINE_MODE_WHITE_LINE)
+
+struct pixy2_emul_config {
+	/* firmware type, tells the emulated cameras apart */
+	const char *fw_type;
+	uint32_t idle_bytes;
+	uint32_t byte_time_ns;
+	uint32_t processing_delay_us;
+	uint32_t frame_period_us;
+};
+
+struct pixy2_emul_data {
+	/* request being assembled */
+	uint8_t req[sizeof(struct pixy2_checksum_header) + PIXY2_MAX_PAYLOAD_LEN];
+	size_t req_len;
+	/* reply being clocked out */
+	uint8_t reply[sizeof(struct pixy2_checksum_header) + PIXY2_MAX_PAYLOAD_LEN];
+	size_t reply_len;
+	size_t reply_pos;
+	/* idle bytes left to clock out before the reply */
+	uint32_t idle_left;
+	/* time at which the reply becomes available (ns) */
+	uint64_t ready_at;
+	/* frame counter, used when there's no frame period */
+	uint32_t frame;
+	/* last frame served by getMainFeatures() and getBlocks() */
+	uint32_t features_frame;
+	uint32_t blocks_frame;
+	/* line tracking settings */
+	struct pixy2_emul_line line;
+};
+
+/* hardware and firmware versions, followed by the firmware type */
+static const uint8_t pixy2_emul_version[] = {
+	0x0, 0x22, 0x3, 0x0, 0x12, 0x0,
+};
+
+static uint64_t pixy2_emul_now(void)
+{
+	return k_cyc_to_ns_floor64(k_cycle_get_64());
+}
+
+static void pixy2_emul_bus_wait(const struct pixy2_emul_config *cfg, size_t len)
+{
+	if (cfg->byte_time_ns) {
+		k_busy_wait(DIV_ROUND_UP((uint64_t)len * cfg->byte_time_ns,
+					 NSEC_PER_USEC));
+	}
+}
+
+static uint32_t pixy2_emul_current_frame(const struct pixy2_emul_config *cfg,
+					 struct pixy2_emul_data *data,
+					 uint64_t now)
+{
+	if (!cfg->frame_period_us) {
+		return ++data->frame;
+	}
+
+	/* frame 0 is never served, it marks "nothing served yet" */
+	return now / NSEC_PER_USEC / cfg->frame_period_us + 1;
+}
+
+/* triangle wave going from -range to range and back */
+static int pixy2_emul_sway(uint32_t frame, int range)
+{
+	int phase;
+
+	phase = frame % PIXY2_EMUL_SWAY_FRAMES;
+	if (phase >= PIXY2_EMUL_SWAY_FRAMES / 2) {
+		phase = PIXY2_EMUL_SWAY_FRAMES - phase;
+	}
+
+	return (phase * 4 * range) / PIXY2_EMUL_SWAY_FRAMES - range;
+}
+
+static uint8_t *pixy2_emul_reply_begin(struct pixy2_emul_data *data,
+				       uint8_t type)
+{
+	struct pixy2_checksum_header *hdr;
+
+	hdr = (struct pixy2_checksum_header *)data->reply;
+
+	hdr->sync0 = PIXY2_REPLY_SYNC0;
+	hdr->sync1 = PIXY2_REPLY_SYNC1;
+	hdr->type = type;
+	hdr->len = 0;
+
+	return data->reply + sizeof(*hdr);
+}
+
+static void pixy2_emul_reply_end(struct pixy2_emul_data *data, uint8_t len)
+{
+	int i;
+	uint16_t checksum;
+	struct pixy2_checksum_header *hdr;
+
+	hdr = (struct pixy2_checksum_header *)data->reply;
+
+	for (i = 0, checksum = 0; i < len; i++) {
+		checksum += data->reply[sizeof(*hdr) + i];
+	}
+
+	hdr->len = len;
+	hdr->checksum = sys_cpu_to_le16(checksum);
+
+	data->reply_len = sizeof(*hdr) + len;
+	data->reply_pos = 0;
+}
+
+static void pixy2_emul_reply_result(struct pixy2_emul_data *data,
+				    uint8_t type, int32_t result)
+{
+	uint8_t *payload;
+
+	/* the payload follows the 6-byte header, it's not aligned */
+	payload = pixy2_emul_reply_begin(data, type);
+	sys_put_le32(result, payload);
+
+	pixy2_emul_reply_end(data, sizeof(result));
+}
+
+static void pixy2_emul_reply_features(struct pixy2_emul_data *data,
+				      uint32_t frame, uint8_t features)
+{
+	int i, sway;
+	uint8_t *payload, len, num_vectors;
+	struct pixy2_vector *v, tmp;
+	struct pixy2_barcode *b;
+	const struct pixy2_emul_line *line = &data->line;
+
+	payload = pixy2_emul_reply_begin(data, PIXY2_REPLY_GET_MAIN_FEATURES);
+	sway = pixy2_emul_sway(frame, 8);
+	len = 0;
+
+	if (features & PIXY2_LINE_VECTOR) {
+		/* left and right track boundaries */
+		struct pixy2_vector vectors[PIXY2_EMUL_NUM_VECTORS] = {
+			{
+				.x0 = 10 + sway, .y0 = 51,
+				.x1 = 25 + 2 * sway, .y1 = 0,
+				.index = 0,
+			},
+			{
+				.x0 = 68 + sway, .y0 = 51,
+				.x1 = 53 + 2 * sway, .y1 = 0,
+				.index = 1,
+			},
+		};
+
+		v = (struct pixy2_vector *)&payload[len + 2];
+		num_vectors = 0;
+
+		for (i = 0; i < PIXY2_EMUL_NUM_VECTORS; i++) {
+			/* only the selected vector is tracked in manual mode */
+			if ((line->mode & PIXY2_LINE_MODE_MANUAL_SELECT_VECTOR) &&
+			    i != line->vector) {
+				continue;
+			}
+
+			tmp = vectors[i];
+
+			if (line->reversed & BIT(i)) {
+				tmp.x0 = vectors[i].x1;
+				tmp.y0 = vectors[i].y1;
+				tmp.x1 = vectors[i].x0;
+				tmp.y1 = vectors[i].y0;
+			}
+
+			v[num_vectors++] = tmp;
+		}
+
+		payload[len++] = PIXY2_LINE_VECTOR;
+		payload[len++] = num_vectors * sizeof(*v);
+
+		len += num_vectors * sizeof(*v);
+	}
+
+	if (features & PIXY2_LINE_BARCODE) {
+		payload[len++] = PIXY2_LINE_BARCODE;
+		payload[len++] = sizeof(*b);
+
+		b = (struct pixy2_barcode *)&payload[len];
+
+		*b = (struct pixy2_barcode) {
+			.x = 39 + sway, .y = 10, .code = frame % 16,
+		};
+
+		len += sizeof(*b);
+	}
+
+	pixy2_emul_reply_end(data, len);
+}
+
+static void pixy2_emul_reply_blocks(struct pixy2_emul_data *data,
+				    uint32_t frame, uint8_t sigmap,
+				    uint8_t max_blocks)
+{
+	int i, sway, num_blocks;
+	struct pixy2_block *b;
+
+	b = (struct pixy2_block *)pixy2_emul_reply_begin(data,
+							 PIXY2_REPLY_GET_BLOCKS);
+	sway = pixy2_emul_sway(frame, 100);
+	num_blocks = 0;
+
+	/* one block per signature 1 and 2, moving in opposite directions */
+	for (i = 0; i < 2 && num_blocks < max_blocks; i++) {
+		if (!(sigmap & BIT(i))) {
+			continue;
+		}
+
+		b[num_blocks++] = (struct pixy2_block) {
+			.signature = sys_cpu_to_le16(i + 1),
+			.x = sys_cpu_to_le16(158 + (i ? -sway : sway)),
+			.y = sys_cpu_to_le16(104),
+			.width = sys_cpu_to_le16(20),
+			.height = sys_cpu_to_le16(30),
+			.index = i,
+			.age = MIN(frame, UINT8_MAX),
+		};
+	}
+
+	pixy2_emul_reply_end(data, num_blocks * sizeof(*b));
+}
+
+/* setMode(), setVector(), setNextTurn(), setDefaultTurn(), reverseVector() */
+static int32_t pixy2_emul_line_request(struct pixy2_emul_line *line,
+				       uint8_t type, uint8_t len,
+				       const uint8_t *args)
+{
+	switch (type) {
+	case PIXY2_REQUEST_SET_MODE:
+		if (len < PIXY2_REQUEST_LEN_SET_MODE ||
+		    (args[0] & ~PIXY2_EMUL_LINE_MODES)) {
+			return PIXY2_ERROR;
+		}
+
+		line->mode = args[0];
+		break;
+	case PIXY2_REQUEST_SET_VECTOR:
+		if (len < PIXY2_REQUEST_LEN_SET_VECTOR ||
+		    args[0] >= PIXY2_EMUL_NUM_VECTORS) {
+			return PIXY2_ERROR;
+		}
+
+		line->vector = args[0];
+		break;
+	case PIXY2_REQUEST_SET_NEXT_TURN:
+		if (len < PIXY2_REQUEST_LEN_SET_NEXT_TURN) {
+			return PIXY2_ERROR;
+		}
+
+		line->next_turn = sys_get_le16(args);
+		break;
+	case PIXY2_REQUEST_SET_DEFAULT_TURN:
+		if (len < PIXY2_REQUEST_LEN_SET_DEFAULT_TURN) {
+			return PIXY2_ERROR;
+		}
+
+		line->default_turn = sys_get_le16(args);
+		break;
+	case PIXY2_REQUEST_REVERSE_VECTOR:
+		/* the camera reverses the vector it's tracking */
+		line->reversed ^= BIT(line->vector);
+		break;
+	default:
+		return PIXY2_ERROR;
+	}
+
+	return PIXY2_OK;
+}
+
+static void pixy2_emul_handle_request(const struct pixy2_emul_config *cfg,
+				      struct pixy2_emul_data *data,
+				      uint64_t now)
+{
+	int i;
+	uint8_t type, len, *args, *payload;
+	uint16_t checksum;
+	uint32_t frame;
+	struct pixy2_checksum_header *hdr;
+
+	hdr = (struct pixy2_checksum_header *)data->req;
+	type = hdr->type;
+	len = hdr->len;
+
+	if (hdr->sync0 == PIXY2_REQUEST_SYNC0_CHECKSUM) {
+		args = data->req + sizeof(struct pixy2_checksum_header);
+
+		for (i = 0, checksum = 0; i < len; i++) {
+			checksum += args[i];
+		}
+
+		if (checksum != sys_le16_to_cpu(hdr->checksum)) {
+			pixy2_emul_reply_result(data, PIXY2_REPLY_ERROR,
+						PIXY2_CHECKSUM_ERROR);
+			goto out_ready;
+		}
+	} else {
+		args = data->req + sizeof(struct pixy2_header);
+	}
+
+	switch (type) {
+	case PIXY2_REQUEST_GET_VERSION:
+		payload = pixy2_emul_reply_begin(data, PIXY2_REPLY_GET_VERSION);
+
+		memcpy(payload, pixy2_emul_version, sizeof(pixy2_emul_version));
+		strncpy((char *)&payload[sizeof(pixy2_emul_version)],
+			cfg->fw_type, PIXY2_EMUL_FW_TYPE_LEN);
+
+		pixy2_emul_reply_end(data, sizeof(pixy2_emul_version) +
+				     PIXY2_EMUL_FW_TYPE_LEN);
+		break;
+	case PIXY2_REQUEST_SET_LED:
+	case PIXY2_REQUEST_SET_LAMP:
+		/* nothing to light up */
+		pixy2_emul_reply_result(data, PIXY2_EMUL_REPLY_RESULT, PIXY2_OK);
+		break;
+	case PIXY2_REQUEST_SET_MODE:
+	case PIXY2_REQUEST_SET_VECTOR:
+	case PIXY2_REQUEST_SET_NEXT_TURN:
+	case PIXY2_REQUEST_SET_DEFAULT_TURN:
+	case PIXY2_REQUEST_REVERSE_VECTOR:
+		pixy2_emul_reply_result(data, PIXY2_EMUL_REPLY_RESULT,
+					pixy2_emul_line_request(&data->line, type,
+								len, args));
+		break;
+	case PIXY2_REQUEST_GET_MAIN_FEATURES:
+		if (len < sizeof(struct pixy2_features_args)) {
+			pixy2_emul_reply_result(data, PIXY2_REPLY_ERROR,
+						PIXY2_ERROR);
+			break;
+		}
+
+		frame = pixy2_emul_current_frame(cfg, data, now);
+		if (frame == data->features_frame) {
+			pixy2_emul_reply_result(data, PIXY2_REPLY_ERROR,
+						PIXY2_BUSY);
+			break;
+		}
+
+		data->features_frame = frame;
+		pixy2_emul_reply_features(data, frame, args[1]);
+		break;
+	case PIXY2_REQUEST_GET_BLOCKS:
+		if (len < 2) {
+			pixy2_emul_reply_result(data, PIXY2_REPLY_ERROR,
+						PIXY2_ERROR);
+			break;
+		}
+
+		frame = pixy2_emul_current_frame(cfg, data, now);
+		if (frame == data->blocks_frame) {
+			pixy2_emul_reply_result(data, PIXY2_REPLY_ERROR,
+						PIXY2_BUSY);
+			break;
+		}
+
+		data->blocks_frame = frame;
+		pixy2_emul_reply_blocks(data, frame, args[0], args[1]);
+		break;
+	default:
+		LOG_WRN("unknown request type: 0x%x", type);
+		pixy2_emul_reply_result(data, PIXY2_REPLY_ERROR, PIXY2_ERROR);
+		break;
+	}
+
+out_ready:
+	data->ready_at = now + (uint64_t)cfg->processing_delay_us * NSEC_PER_USEC;
+	data->idle_left = cfg->idle_bytes;
+}
+
+static void pixy2_emul_write_byte(const struct pixy2_emul_config *cfg,
+				  struct pixy2_emul_data *data,
+				  uint8_t byte, uint64_t now)
+{
+	size_t hdr_len;
+
+	/* skip anything that's not the beginning of a request */
+	if (!data->req_len && byte != PIXY2_REQUEST_SYNC0_NO_CHECKSUM &&
+	    byte != PIXY2_REQUEST_SYNC0_CHECKSUM) {
+		return;
+	}
+
+	if (data->req_len == 1 && byte != PIXY2_REQUEST_SYNC1_NO_CHECKSUM) {
+		data->req_len = 0;
+		return;
+	}
+
+	data->req[data->req_len++] = byte;
+
+	hdr_len = data->req[0] == PIXY2_REQUEST_SYNC0_CHECKSUM ?
+		sizeof(struct pixy2_checksum_header) : sizeof(struct pixy2_header);
+
+	if (data->req_len < hdr_len ||
+	    data->req_len < hdr_len + ((struct pixy2_header *)data->req)->len) {
+		return;
+	}
+
+	/* a new request discards whatever is left of the previous reply */
+	pixy2_emul_handle_request(cfg, data, now);
+	data->req_len = 0;
+}
+
+static uint8_t pixy2_emul_read_byte(struct pixy2_emul_data *data, uint64_t now)
+{
+	if (data->reply_pos >= data->reply_len || now < data->ready_at) {
+		return PIXY2_EMUL_IDLE_BYTE;
+	}
+
+	if (data->idle_left) {
+		data->idle_left--;
+		return PIXY2_EMUL_IDLE_BYTE;
+	}
+
+	return data->reply[data->reply_pos++];
+}
+
+#if DT_ANY_INST_ON_BUS_STATUS_OKAY(i2c)
+static int pixy2_emul_i2c_transfer(const struct emul *target,
+				   struct i2c_msg *msgs, int num_msgs,
+				   int addr)
+{
+	int i;
+	uint32_t j;
+	uint64_t now;
+	bool start;
+	const struct pixy2_emul_config *cfg = target->cfg;
+	struct pixy2_emul_data *data = target->data;
+
+	ARG_UNUSED(addr);
+
+	for (i = 0; i < num_msgs; i++) {
+		now = pixy2_emul_now();
+
+		if ((msgs[i].flags & I2C_MSG_RW_MASK) == I2C_MSG_WRITE) {
+			for (j = 0; j < msgs[i].len; j++) {
+				pixy2_emul_write_byte(cfg, data, msgs[i].buf[j], now);
+			}
+		} else {
+			/* the camera stretches the clock until the reply is ready */
+			if (now < data->ready_at) {
+				k_busy_wait(DIV_ROUND_UP(data->ready_at - now,
+							 NSEC_PER_USEC));
+				now = data->ready_at;
+			}
+
+			/* no idle bytes over I2C */
+			data->idle_left = 0;
+
+			for (j = 0; j < msgs[i].len; j++) {
+				msgs[i].buf[j] = pixy2_emul_read_byte(data, now);
+			}
+		}
+
+		/*
+		 * the address byte only goes out after a (repeated) start.
+		 * Messages continuing the previous one carry data only.
+		 */
+		start = !i || (msgs[i].flags & I2C_MSG_RESTART) ||
+			(msgs[i - 1].flags & I2C_MSG_STOP) ||
+			((msgs[i].flags ^ msgs[i - 1].flags) & I2C_MSG_RW_MASK);
+
+		pixy2_emul_bus_wait(cfg, msgs[i].len + start);
+	}
+
+	return 0;
+}
+
+static const struct i2c_emul_api pixy2_emul_i2c_api = {
+	.transfer = pixy2_emul_i2c_transfer,
+};
+#endif /* DT_ANY_INST_ON_BUS_STATUS_OKAY(i2c) */
+
+#if DT_ANY_INST_ON_BUS_STATUS_OKAY(spi)
+static size_t pixy2_emul_spi_flatten(const struct spi_buf_set *set,
+				     uint8_t *buf, bool copy)
+{
+	size_t i, len;
+
+	if (!set) {
+		return 0;
+	}
+
+	for (i = 0, len = 0; i < set->count; i++) {
+		if (len + set->buffers[i].len > PIXY2_EMUL_MAX_XFER_LEN) {
+			return SIZE_MAX;
+		}
+
+		/* NULL TX buffers clock out zeros */
+		if (copy) {
+			if (set->buffers[i].buf) {
+				memcpy(&buf[len], set->buffers[i].buf,
+				       set->buffers[i].len);
+			} else {
+				memset(&buf[len], 0, set->buffers[i].len);
+			}
+		}
+
+		len += set->buffers[i].len;
+	}
+
+	return len;
+}
+
+static void pixy2_emul_spi_scatter(const struct spi_buf_set *set,
+				   const uint8_t *buf)
+{
+	size_t i, len;
+
+	for (i = 0, len = 0; i < set->count; i++) {
+		/* NULL RX buffers discard the received bytes */
+		if (set->buffers[i].buf) {
+			memcpy(set->buffers[i].buf, &buf[len],
+			       set->buffers[i].len);
+		}
+
+		len += set->buffers[i].len;
+	}
+}
+
+static int pixy2_emul_spi_io(const struct emul *target,
+			     const struct spi_config *config,
+			     const struct spi_buf_set *tx_bufs,
+			     const struct spi_buf_set *rx_bufs)
+{
+	size_t i, tx_len, rx_len;
+	uint64_t now;
+	uint8_t tx[PIXY2_EMUL_MAX_XFER_LEN], rx[PIXY2_EMUL_MAX_XFER_LEN];
+	const struct pixy2_emul_config *cfg = target->cfg;
+	struct pixy2_emul_data *data = target->data;
+
+	ARG_UNUSED(config);
+
+	tx_len = pixy2_emul_spi_flatten(tx_bufs, tx, true);
+	rx_len = pixy2_emul_spi_flatten(rx_bufs, NULL, false);
+
+	if (tx_len == SIZE_MAX || rx_len == SIZE_MAX) {
+		LOG_ERR("transfer too long");
+		return -EINVAL;
+	}
+
+	now = pixy2_emul_now();
+
+	/* full duplex - each byte in goes with a byte out */
+	for (i = 0; i < MAX(tx_len, rx_len); i++) {
+		rx[i] = pixy2_emul_read_byte(data, now);
+
+		if (i < tx_len) {
+			pixy2_emul_write_byte(cfg, data, tx[i], now);
+		}
+
+		now += cfg->byte_time_ns;
+	}
+
+	if (rx_len) {
+		pixy2_emul_spi_scatter(rx_bufs, rx);
+	}
+
+	pixy2_emul_bus_wait(cfg, MAX(tx_len, rx_len));
+
+	return 0;
+}
+
+static const struct spi_emul_api pixy2_emul_spi_api = {
+	.io = pixy2_emul_spi_io,
+};
+#endif /* DT_ANY_INST_ON_BUS_STATUS_OKAY(spi) */
+
+int pixy2_emul_get_line(const struct emul *target,
+			struct pixy2_emul_line *line)
+{
+	const struct pixy2_emul_data *data = target->data;
+
+	*line = data->line;
+
+	return 0;
+}
+
+static int pixy2_emul_init(const struct emul *target,
+			   const struct device *parent)
+{
+	struct pixy2_emul_data *data = target->data;
+
+	ARG_UNUSED(parent);
+
+	memset(data, 0, sizeof(*data));
+
+	return 0;
+}
+
+#define PIXY2_EMUL_DEFINE(inst)							\
+	static struct pixy2_emul_data pixy2_emul_data_##inst;			\
+										\
+	static const struct pixy2_emul_config pixy2_emul_config_##inst = {	\
+		.fw_type = COND_CODE_1(DT_INST_ON_BUS(inst, i2c),		\
+				       ("emul i2c"), ("emul spi")),		\
+		.idle_bytes = DT_INST_PROP(inst, idle_bytes),			\
+		.byte_time_ns = DT_INST_PROP(inst, byte_time_ns),		\
+		.processing_delay_us = DT_INST_PROP(inst, processing_delay_us),	\
+		.frame_period_us = DT_INST_PROP(inst, frame_period_us),		\
+	};									\
+										\
+	/* the emulated camera has no driver, give it a placeholder device */	\
+	DEVICE_DT_INST_DEFINE(inst, NULL, NULL, NULL, NULL, POST_KERNEL,	\
+			      CONFIG_APPLICATION_INIT_PRIORITY, NULL);		\
+										\
+	EMUL_DT_INST_DEFINE(inst, pixy2_emul_init, &pixy2_emul_data_##inst,	\
+			    &pixy2_emul_config_##inst,				\
+			    COND_CODE_1(DT_INST_ON_BUS(inst, i2c),		\
+					(&pixy2_emul_i2c_api),			\
+					(&pixy2_emul_spi_api)),			\
+			    NULL)
+
+DT_INST_FOREACH_STATUS_OKAY(PIXY2_EMUL_DEFINE)
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file pixy2_emul.h
+ * @brief Pixy2 camera emulator backend API
+ *
+ * Lets tests inspect the state the emulated camera was left in by the
+ * commands sent to it.
+ */
+
+#ifndef _PIXY2_EMUL_H_
+#define _PIXY2_EMUL_H_
+
+#include <zephyr/drivers/emul.h>
+
+/**
+ * @struct pixy2_emul_line
+ * @brief Line tracking settings of an emulated camera
+ */
+struct pixy2_emul_line {
+	/** line tracking mode - see @ref Pixy2LineModes */
+	uint8_t mode;
+	/** tracking index of the vector selected via setVector() */
+	uint8_t vector;
+	/** bitmask of the vectors reversed via reverseVector(), by index */
+	uint8_t reversed;
+	/** angle set via setNextTurn() (in degrees) */
+	int16_t next_turn;
+	/** angle set via setDefaultTurn() (in degrees) */
+	int16_t default_turn;
+};
+
+/**
+ * @brief Get the line tracking settings of an emulated camera
+ *
+ * @param target pointer to the emulator
+ * @param line pointer to the structure receiving the settings
+ *
+ * @retval 0 if success
+ */
+int pixy2_emul_get_line(const struct emul *target,
+			struct pixy2_emul_line *line);
+
+#endif /* _PIXY2_EMUL_H_ */
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+
+#include "pixy2_pipeline.h"
+
+LOG_MODULE_REGISTER(pixy2_pipeline);
+
+static int pixy2_pipeline_submit(struct pixy2_pipeline *p, int idx)
+{
+	int ret;
+
+	ret = pixy2_submit_main_features(p->t, &p->xfer, p->features,
+					 &p->frames[idx]);
+	if (ret) {
+		LOG_ERR("failed to submit frame request: %d", ret);
+		return ret;
+	}
+
+	p->bus = idx;
+
+	return 0;
+}
+
+int pixy2_pipeline_start(struct pixy2_pipeline *p)
+{
+	/* sanity checks */
+	if (!p || !p->t) {
+		return -EINVAL;
+	}
+
+	if (p->bus >= 0) {
+		return -EALREADY;
+	}
+
+	return pixy2_pipeline_submit(p, 0);
+}
+
+int pixy2_pipeline_get(struct pixy2_pipeline *p, struct pixy2_features **f,
+		       bool wait)
+{
+	int ret, idx;
+
+	/* sanity checks */
+	if (!p || !p->t || !f) {
+		return -EINVAL;
+	}
+
+	/* the next request needs the buffer held by the application */
+	if (p->app >= 0) {
+		return -EBUSY;
+	}
+
+	/* nothing in flight (e.g. previous error), start over */
+	if (p->bus < 0) {
+		ret = pixy2_pipeline_submit(p, 0);
+		if (ret) {
+			return ret;
+		}
+	}
+
+	ret = pixy2_complete_main_features(p->t, &p->xfer, wait);
+	if (ret == -EAGAIN) {
+		return ret;
+	}
+
+	idx = p->bus;
+	p->bus = -1;
+
+	/*
+	 * no new frame yet, ask again using the same buffer. The caller
+	 * comes back later instead of keeping the bus busy until there is.
+	 */
+	if (ret == -EBUSY) {
+		ret = pixy2_pipeline_submit(p, idx);
+		return ret ? ret : -EAGAIN;
+	}
+
+	if (ret) {
+		LOG_ERR("failed to receive frame: %d", ret);
+		return ret;
+	}
+
+	p->app = idx;
+	*f = &p->frames[idx];
+
+	/* request the next frame while the application works on this one */
+	ret = pixy2_pipeline_submit(p, (idx + 1) % PIXY2_PIPELINE_NUM_FRAMES);
+	if (ret) {
+		/* the frame is still good, the next call starts over */
+		LOG_WRN("failed to request next frame: %d", ret);
+	}
+
+	return 0;
+}
+
+void pixy2_pipeline_put(struct pixy2_pipeline *p, struct pixy2_features *f)
+{
+	if (p->app >= 0 && f == &p->frames[p->app]) {
+		p->app = -1;
+	}
+}
+
+void pixy2_pipeline_stop(struct pixy2_pipeline *p)
+{
+	if (p->bus < 0) {
+		return;
+	}
+
+	pixy2_complete_main_features(p->t, &p->xfer, true);
+
+	p->bus = -1;
+}
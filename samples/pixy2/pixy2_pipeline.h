@@ -0,0 +1,121 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file pixy2_pipeline.h
+ * @brief Pixy2 pipelined frame acquisition API
+ *
+ * This file offers an API for acquiring line tracking frames (i.e. the
+ * result of the getMainFeatures() command) in a pipelined fashion: the
+ * request for frame N + 1 is already on the bus while the application
+ * processes frame N.
+ *
+ * The pipeline uses two frame buffers. At any given time, a buffer is
+ * either owned by the pipeline (free or being filled by the transport)
+ * or by the application. The application gets ownership of a frame via
+ * @ref pixy2_pipeline_get and gives it back via @ref pixy2_pipeline_put.
+ * Frames are never copied.
+ */
+
+#ifndef _PIXY2_PIPELINE_H_
+#define _PIXY2_PIPELINE_H_
+
+#include "pixy2_command.h"
+
+/** number of frame buffers used by the pipeline */
+#define PIXY2_PIPELINE_NUM_FRAMES 2
+
+/**
+ * @struct pixy2_pipeline
+ * @brief Pixy2 frame acquisition pipeline
+ */
+struct pixy2_pipeline {
+	/** transport used for talking to the camera */
+	struct pixy2_transport *t;
+	/** bitmask of requested features - see @ref Pixy2LineFeatures */
+	uint8_t features;
+	/** frame buffers */
+	struct pixy2_features frames[PIXY2_PIPELINE_NUM_FRAMES];
+	/** in-flight getMainFeatures() command */
+	struct pixy2_features_xfer xfer;
+	/** index of the frame owned by the transport, -1 if none */
+	int bus;
+	/** index of the frame owned by the application, -1 if none */
+	int app;
+};
+
+/**
+ * @brief Prepare a pixy2_pipeline structure
+ *
+ * @param transport pointer to the generic transport layer data
+ * @param f bitmask of requested features - see @ref Pixy2LineFeatures
+ */
+#define PIXY2_PIPELINE(transport, f)	\
+{					\
+	.t = transport,			\
+	.features = f,			\
+	.bus = -1,			\
+	.app = -1,			\
+}
+
+/**
+ * @brief Start the pipeline
+ *
+ * Submit the request for the first frame.
+ *
+ * @param p pointer to the pipeline
+ *
+ * @retval 0 if success
+ * @retval -EALREADY if the pipeline is already started
+ * @retval negative errno code if error
+ */
+int pixy2_pipeline_start(struct pixy2_pipeline *p);
+
+/**
+ * @brief Get the next frame
+ *
+ * Collect the frame currently being acquired, submit the request for
+ * the following one and hand the received frame over to the application.
+ * If the camera reports it has no new frame yet, the request is re-issued
+ * once and -EAGAIN is returned, such that the caller may do something else
+ * (e.g. run its control loop on the previous frame) before trying again.
+ * If the pipeline is not started, this starts it.
+ *
+ * The previous frame needs to be given back using @ref pixy2_pipeline_put
+ * before calling this.
+ *
+ * @param p pointer to the pipeline
+ * @param f will point to the received frame on success
+ * @param wait true if the call should block until the request in flight
+ * is completed, false otherwise. The call never blocks for longer than a
+ * single request/reply pair.
+ *
+ * @retval 0 if success
+ * @retval -EAGAIN if no new frame is available yet
+ * @retval -EBUSY if the application still owns the previous frame
+ * @retval negative errno code if error
+ */
+int pixy2_pipeline_get(struct pixy2_pipeline *p, struct pixy2_features **f,
+		       bool wait);
+
+/**
+ * @brief Give a frame back to the pipeline
+ *
+ * @param p pointer to the pipeline
+ * @param f frame previously returned by @ref pixy2_pipeline_get
+ */
+void pixy2_pipeline_put(struct pixy2_pipeline *p, struct pixy2_features *f);
+
+/**
+ * @brief Stop the pipeline
+ *
+ * Wait for the in-flight request (if any) to finish and discard its reply.
+ *
+ * @param p pointer to the pipeline
+ */
+void pixy2_pipeline_stop(struct pixy2_pipeline *p);
+
+#endif /* _PIXY2_PIPELINE_H_ */
@@ -10,24 +10,36 @@
 
 LOG_MODULE_REGISTER(pixy2_protocol);
 
-static int get_reply_type(int request_type)
-{
-	switch (request_type) {
-	case PIXY2_REQUEST_GET_VERSION:
-		return PIXY2_REPLY_GET_VERSION;
-	case PIXY2_REQUEST_SET_LED:
-		return PIXY2_REPLY_SET_LED;
-	case PIXY2_REQUEST_SET_LAMP:
-		return PIXY2_REPLY_SET_LAMP;
-	case PIXY2_REQUEST_GET_MAIN_FEATURES:
-		return PIXY2_REPLY_GET_MAIN_FEATURES;
-	default:
-		LOG_ERR("unknown request type: 0x%x", request_type);
-		return -EINVAL;
-	}
+/* what is expected of the reply to a request */
+struct pixy2_command_info {
+	uint8_t reply_type;
+	uint8_t req_len;
+	uint8_t min_reply_len;
+	uint8_t max_reply_len;
+};
 
-	CODE_UNREACHABLE;
-}
+#define PIXY2_COMMAND_INFO(name, req, reply, len, min, max)	\
+	[req] = {						\
+		.reply_type = reply,				\
+		.req_len = len,					\
+		.min_reply_len = min,				\
+		.max_reply_len = max,				\
+	},
+
+#define PIXY2_COMMAND_CHECK(name, req, reply, len, min, max)		\
+	BUILD_ASSERT(req <= PIXY2_MAX_REQUEST_TYPE, "bad request type");	\
+	BUILD_ASSERT(reply != 0 && reply != PIXY2_REPLY_ERROR,		\
+		     "bad reply type");					\
+	BUILD_ASSERT(len <= PIXY2_MAX_PAYLOAD_LEN, "bad request length");	\
+	BUILD_ASSERT(min <= max && max <= PIXY2_MAX_PAYLOAD_LEN,		\
+		     "bad reply length");
+
+PIXY2_COMMANDS(PIXY2_COMMAND_CHECK)
+
+/* indexed by request type, unknown requests have a 0 reply type */
+static const struct pixy2_command_info pixy2_commands[PIXY2_MAX_REQUEST_TYPE + 1] = {
+	PIXY2_COMMANDS(PIXY2_COMMAND_INFO)
+};
 
 int pixy2_to_errno(int32_t result)
 {
@@ -38,8 +50,9 @@ int pixy2_to_errno(int32_t result)
 		return -EBUSY;
 	case PIXY2_TIMEOUT:
 		return -ETIME;
-	case PIXY2_ERROR:
 	case PIXY2_CHECKSUM_ERROR:
+		return -EILSEQ;
+	case PIXY2_ERROR:
 	case PIXY2_BUTTON_OVERRIDE:
 	case PIXY2_PROG_CHANGING:
 		return -EIO;
@@ -51,57 +64,262 @@ int pixy2_to_errno(int32_t result)
 	CODE_UNREACHABLE;
 }
 
+/*
+ * look up the request and set up the reply so that the transport layer
+ * can reject malformed replies as soon as their header is received.
+ */
+static int pixy2_protocol_prepare(struct pixy2_message *req,
+				  struct pixy2_message *reply)
+{
+	const struct pixy2_command_info *info;
+
+	if (req->hdr.type > PIXY2_MAX_REQUEST_TYPE ||
+	    !pixy2_commands[req->hdr.type].reply_type) {
+		LOG_ERR("unknown request type: 0x%x", req->hdr.type);
+		return -EINVAL;
+	}
+
+	info = &pixy2_commands[req->hdr.type];
+
+	if (req->hdr.len != info->req_len) {
+		LOG_ERR("invalid request length: %d (expected) vs %d (actual)",
+			info->req_len, req->hdr.len);
+		return -EINVAL;
+	}
+
+	/* the reply needs to fit whether it's an error or not */
+	if (reply->hdr.len < MAX(info->min_reply_len, sizeof(int32_t))) {
+		LOG_ERR("reply buffer too small: %d", reply->hdr.len);
+		return -EINVAL;
+	}
+
+	reply->hdr.type = info->reply_type;
+	reply->hdr.len = MIN(reply->hdr.len, info->max_reply_len);
+	reply->min_len = info->min_reply_len;
+
+	if (req->checksum) {
+		req->hdr.sync0 = PIXY2_REQUEST_SYNC0_CHECKSUM;
+		req->hdr.sync1 = PIXY2_REQUEST_SYNC1_CHECKSUM;
+		req->hdr.checksum = sys_cpu_to_le16(pixy2_checksum(req->payload,
+								    req->hdr.len));
+	}
+
+	return 0;
+}
+
+/*
+ * transport errors meaning the camera is most likely out of sync. Other
+ * bus errors (e.g. NACK) say nothing about the camera's state and aren't
+ * worth the cost of a recovery.
+ */
+static bool pixy2_protocol_out_of_sync(int ret)
+{
+	return ret == -EBADMSG || ret == -ETIME;
+}
+
+/*
+ * the transport layer already rejected malformed reply headers, as far as
+ * its caller told it what to expect. Returns -EILSEQ if either the reply
+ * or the request (as seen by the camera) was corrupted and -EBADMSG if the
+ * reply doesn't answer the request, in which case the request is worth
+ * sending again.
+ */
+static int pixy2_protocol_validate(struct pixy2_message *reply, uint8_t type)
+{
+	int ret;
+
+	ret = pixy2_protocol_check_payload(reply);
+	if (ret) {
+		return ret;
+	}
+
+	/* pixy2 may answer with ERROR type instead of the expected type */
+	if (reply->hdr.type == PIXY2_REPLY_ERROR) {
+		/* BUSY is part of normal operation (e.g. no new frame yet) */
+		if (*(int32_t *)reply->payload != PIXY2_BUSY &&
+		    *(int32_t *)reply->payload != PIXY2_CHECKSUM_ERROR) {
+			LOG_ERR("received error reply with status: %d",
+				*(int32_t *)reply->payload);
+		}
+
+		return pixy2_to_errno(*(int32_t *)reply->payload);
+	}
+
+	/* validate reply type, whatever the transport layer was told */
+	if (reply->hdr.type != type) {
+		LOG_ERR("reply type mis-match: 0x%x (expected) vs 0x%x (actual)",
+			type, reply->hdr.type);
+		return -EBADMSG;
+	}
+
+	return 0;
+}
+
+/* true if the validation failure is worth sending the request again */
+static bool pixy2_protocol_invalid(int ret)
+{
+	return ret == -EILSEQ || ret == -EBADMSG;
+}
+
+/*
+ * get ready for sending the request again after a failed attempt. Returns
+ * the attempt's error if it's not worth retrying.
+ */
+static int pixy2_protocol_retry(struct pixy2_transport *t, int err)
+{
+	int ret;
+
+	if (err == -EILSEQ) {
+		LOG_WRN("corrupted message, retrying");
+		return 0;
+	}
+
+	if (!pixy2_protocol_out_of_sync(err)) {
+		return err;
+	}
+
+	LOG_WRN("camera out of sync (%d), recovering", err);
+
+	ret = pixy2_transport_recover(t);
+	if (ret) {
+		LOG_ERR("failed to recover: %d", ret);
+		return ret;
+	}
+
+	return 0;
+}
+
 int pixy2_protocol_transceive(struct pixy2_transport *t,
 			      struct pixy2_message *req,
 			      struct pixy2_message *reply)
 {
-	int ret, expected_reply;
+	int ret, i;
+	struct pixy2_checksum_header expected;
 
 	/* sanity checks */
 	if (!t || !req || !reply || !reply->payload) {
 		return -EINVAL;
 	}
 
-	expected_reply = get_reply_type(req->hdr.type);
-	if (expected_reply < 0) {
-		LOG_ERR("invalid request type: 0x%x", expected_reply);
-		return expected_reply;
-	}
-
-	/* send the request and get its reply */
-	ret = pixy2_transport_transceive(t, req, reply);
+	ret = pixy2_protocol_prepare(req, reply);
 	if (ret) {
-		LOG_ERR("failed to transceive: %d", ret);
 		return ret;
 	}
 
-	/* validate SYNC0 byte */
-	if (reply->hdr.sync0 != PIXY2_REPLY_SYNC0) {
-		LOG_ERR("invalid SYNC0 byte: 0x%x (expected) vs 0x%x (actual)",
-			PIXY2_REPLY_SYNC0, reply->hdr.sync0);
-		return -EINVAL;
+	/* the reply header is overwritten by a failed attempt */
+	expected = reply->hdr;
+
+	for (i = 0; ; i++) {
+		/* send the request and get its reply */
+		ret = pixy2_transport_transceive(t, req, reply);
+		if (!ret) {
+			ret = pixy2_protocol_validate(reply, expected.type);
+			if (!pixy2_protocol_invalid(ret)) {
+				return ret;
+			}
+		}
+
+		if (i == CONFIG_NXPCUP_PIXY2_RETRIES) {
+			/* leave a clean state behind for the next request */
+			if (pixy2_protocol_out_of_sync(ret) && pixy2_transport_recover(t)) {
+				LOG_ERR("failed to recover");
+			}
+
+			break;
+		}
+
+		ret = pixy2_protocol_retry(t, ret);
+		if (ret) {
+			break;
+		}
+
+		reply->hdr = expected;
 	}
 
-	/* validate SYNC1 byte */
-	if (reply->hdr.sync1 != PIXY2_REPLY_SYNC1) {
-		LOG_ERR("invalid SYNC1 byte: 0x%x (expected) vs 0x%x (actual)",
-			PIXY2_REPLY_SYNC1, reply->hdr.sync1);
+	LOG_ERR("failed to transceive: %d", ret);
+
+	return ret;
+}
+
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+int pixy2_protocol_submit(struct pixy2_transport *t,
+			  struct pixy2_message *req,
+			  struct pixy2_message *reply)
+{
+	int ret;
+
+	/* sanity checks */
+	if (!t || !req || !reply || !reply->payload) {
 		return -EINVAL;
 	}
 
-	/* pixy2 may answer with ERROR type instead of the expected type */
-	if (reply->hdr.type == PIXY2_REPLY_ERROR) {
-		LOG_ERR("received error reply with status: %d",
-			*(int32_t *)reply->payload);
-		return pixy2_to_errno(*(int32_t *)reply->payload);
+	ret = pixy2_protocol_prepare(req, reply);
+	if (ret) {
+		return ret;
 	}
 
-	/* validate reply type */
-	if (expected_reply != reply->hdr.type) {
-		LOG_ERR("reply type mis-match: 0x%x (expected) vs 0x%x (actual)",
-			expected_reply, reply->hdr.type);
-		return -EINVAL;
+	ret = pixy2_transport_submit(t, req, reply);
+	if (ret) {
+		LOG_ERR("failed to submit: %d", ret);
+		return ret;
 	}
 
+	t->expected = reply->hdr;
+	t->retries = 0;
+
 	return 0;
 }
+
+int pixy2_protocol_complete(struct pixy2_transport *t,
+			    struct pixy2_message *req,
+			    struct pixy2_message *reply,
+			    bool wait)
+{
+	int ret;
+
+	while (true) {
+		ret = pixy2_transport_complete(t, wait);
+		if (ret == -EAGAIN) {
+			return ret;
+		}
+
+		if (!ret) {
+			ret = pixy2_protocol_validate(reply, t->expected.type);
+			if (!pixy2_protocol_invalid(ret)) {
+				return ret;
+			}
+		}
+
+		if (t->retries == CONFIG_NXPCUP_PIXY2_RETRIES) {
+			/* leave a clean state behind for the next submission */
+			if (pixy2_protocol_out_of_sync(ret) && pixy2_transport_recover(t)) {
+				LOG_ERR("failed to recover");
+			}
+
+			break;
+		}
+
+		ret = pixy2_protocol_retry(t, ret);
+		if (ret) {
+			break;
+		}
+
+		reply->hdr = t->expected;
+		t->retries++;
+
+		ret = pixy2_transport_submit(t, req, reply);
+		if (ret) {
+			LOG_ERR("failed to submit: %d", ret);
+			return ret;
+		}
+
+		if (!wait) {
+			return -EAGAIN;
+		}
+	}
+
+	LOG_ERR("failed to complete: %d", ret);
+
+	return ret;
+}
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
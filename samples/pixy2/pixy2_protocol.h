@@ -17,55 +17,64 @@
 #ifndef _PIXY2_PROTOCOL_H_
 #define _PIXY2_PROTOCOL_H_
 
+#include <zephyr/sys/byteorder.h>
+
 #include "pixy2_transport.h"
 
 /**
- * @defgroup Pixy2RequestTypes
- * @brief Pixy2 request types
+ * @brief Pixy2 command table
  *
- * Possible values for @ref pixy2_checksum_header::type when issuing
- * a request.
+ * Single description of the commands known to the protocol layer. Each
+ * entry is X(name, request type, reply type, request length, minimum reply
+ * length, maximum reply length), lengths being payload lengths in bytes.
+ * Replies of fixed size have equal minimum and maximum lengths.
  *
- * @{
+ * The request/reply types (PIXY2_REQUEST_<name>/PIXY2_REPLY_<name>), the
+ * lengths (PIXY2_REQUEST_LEN_<name>, PIXY2_REPLY_MIN_LEN_<name> and
+ * PIXY2_REPLY_MAX_LEN_<name>) and the lookup table used for validating the
+ * replies are all generated from it.
  */
+#define PIXY2_COMMANDS(X)						\
+	X(GET_VERSION,		0x0e, 0x0f, 0, 16, 16)			\
+	X(SET_LED,		0x14, 0x01, 3, 4, 4)			\
+	X(SET_LAMP,		0x16, 0x01, 2, 4, 4)			\
+	X(GET_BLOCKS,		0x20, 0x21, 2, 0, 255)			\
+	X(GET_MAIN_FEATURES,	0x30, 0x31, 2, 0, 255)			\
+	X(SET_MODE,		0x36, 0x01, 1, 4, 4)			\
+	X(SET_VECTOR,		0x38, 0x01, 1, 4, 4)			\
+	X(SET_NEXT_TURN,	0x3a, 0x01, 2, 4, 4)			\
+	X(SET_DEFAULT_TURN,	0x3c, 0x01, 2, 4, 4)			\
+	X(REVERSE_VECTOR,	0x3e, 0x01, 0, 4, 4)
 
-/** getVersion() command request type */
-#define PIXY2_REQUEST_GET_VERSION		0xe
-/** setLED() command request type */
-#define PIXY2_REQUEST_SET_LED			0x14
-/** setLamp() command request type */
-#define PIXY2_REQUEST_SET_LAMP			0x16
-/** getMainFeatures() command request type */
-#define PIXY2_REQUEST_GET_MAIN_FEATURES		0x30
+/** largest request type found in the command table */
+#define PIXY2_MAX_REQUEST_TYPE			0x3f
 
-/**
- * @}
- */
+#define PIXY2_COMMAND_REQUEST_TYPE(name, req, ...)	\
+	PIXY2_REQUEST_##name = req,
+#define PIXY2_COMMAND_REPLY_TYPE(name, req, reply, ...)	\
+	PIXY2_REPLY_##name = reply,
+#define PIXY2_COMMAND_LENGTHS(name, req, reply, len, min, max)	\
+	PIXY2_REQUEST_LEN_##name = len,				\
+	PIXY2_REPLY_MIN_LEN_##name = min,			\
+	PIXY2_REPLY_MAX_LEN_##name = max,
 
-/**
- * @defgroup Pixy2ReplyTypes
- * @brief Pixy2 reply types
- *
- * Possible values for @ref pixy2_checksum_header::type when receiving
- * a reply.
- *
- * @{
- */
+/** Pixy2 request types */
+enum pixy2_request_type {
+	PIXY2_COMMANDS(PIXY2_COMMAND_REQUEST_TYPE)
+};
 
-/** getVersion() command reply type */
-#define PIXY2_REPLY_GET_VERSION			0xf
-/** setLED() command reply type */
-#define PIXY2_REPLY_SET_LED			0x1
-/** setLamp() command reply type */
-#define PIXY2_REPLY_SET_LAMP			0x1
-/** getMainFeatures() command reply type */
-#define PIXY2_REPLY_GET_MAIN_FEATURES		0x31
-/** error reply type */
-#define PIXY2_REPLY_ERROR			0x3
+/** Pixy2 reply types */
+enum pixy2_reply_type {
+	PIXY2_COMMANDS(PIXY2_COMMAND_REPLY_TYPE)
+};
 
-/**
- * @}
- */
+/** Pixy2 request and reply payload lengths */
+enum pixy2_command_lengths {
+	PIXY2_COMMANDS(PIXY2_COMMAND_LENGTHS)
+};
+
+/** error reply type - may be sent in reply to any request */
+#define PIXY2_REPLY_ERROR			0x3
 
 
 /**
@@ -148,6 +157,90 @@
  */
 
 
+/**
+ * @brief Check a reply header before receiving the reply payload
+ *
+ * Used by the transport layer drivers for rejecting malformed replies
+ * (e.g. bad SYNC bytes, unexpected type or length) as soon as their header
+ * is received. This saves clocking in the rest of a bogus payload, but not
+ * the payload bytes read along with the header (e.g. the SPI reply window
+ * or the speculative read of the combined I2C transport). Error replies
+ * are accepted in reply to any request.
+ *
+ * The protocol layer checks the reply type again, such that its callers
+ * don't depend on what the transport layer was told to expect.
+ *
+ * @param hdr pointer to the received reply header
+ * @param type expected reply type, 0 if any
+ * @param min_len minimum expected payload length
+ * @param max_len maximum expected payload length
+ *
+ * @retval 0 if the header is sane
+ * @retval -EBADMSG otherwise
+ */
+static inline int pixy2_protocol_check_header(const struct pixy2_checksum_header *hdr,
+					      uint8_t type, uint8_t min_len,
+					      uint8_t max_len)
+{
+	if (hdr->sync0 != PIXY2_REPLY_SYNC0 || hdr->sync1 != PIXY2_REPLY_SYNC1) {
+		return -EBADMSG;
+	}
+
+	/* error replies carry a single status code */
+	if (hdr->type == PIXY2_REPLY_ERROR) {
+		return hdr->len == sizeof(int32_t) && hdr->len <= max_len ?
+			0 : -EBADMSG;
+	}
+
+	if ((type && hdr->type != type) ||
+	    hdr->len < min_len || hdr->len > max_len) {
+		return -EBADMSG;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Compute the checksum of a message payload
+ *
+ * @param buf pointer to the payload data
+ * @param len payload length
+ *
+ * @retval 16-bit sum of the payload bytes
+ */
+static inline uint16_t pixy2_checksum(const uint8_t *buf, uint8_t len)
+{
+	uint16_t sum = 0;
+
+	while (len--) {
+		sum += *buf++;
+	}
+
+	return sum;
+}
+
+/**
+ * @brief Check the payload of a received reply against its checksum
+ *
+ * @param reply pointer to the reply data
+ *
+ * @retval 0 if the payload is intact or checksum verification is disabled
+ * @retval -EILSEQ otherwise
+ */
+static inline int pixy2_protocol_check_payload(const struct pixy2_message *reply)
+{
+	if (!reply->checksum) {
+		return 0;
+	}
+
+	if (pixy2_checksum(reply->payload, reply->hdr.len) !=
+	    sys_le16_to_cpu(reply->hdr.checksum)) {
+		return -EILSEQ;
+	}
+
+	return 0;
+}
+
 /**
  * @brief Convert a Pixy2 status code to errno-like code
  *
@@ -164,6 +257,15 @@ int pixy2_to_errno(int32_t result);
  * wait for its reply and then perform some basic sanity checks
  * on it. Upper layers should use this instead of @ref pixy2_transport_transceive.
  *
+ * If checksum verification is enabled, the request checksum is computed
+ * and the reply payload is checked against the reply checksum.
+ *
+ * The request is sent again, up to CONFIG_NXPCUP_PIXY2_RETRIES times, if
+ * the reply is corrupted (i.e. checksum mismatch on either side) or if the
+ * camera turns out to be out of sync (e.g. malformed reply header or no
+ * reply at all). In the latter case, the camera is first recovered using
+ * @ref pixy2_transport_recover.
+ *
  * @param t pointer to the generic transport layer data
  * @param req pointer to the request data
  * @param reply pointer to the reply data
@@ -175,4 +277,45 @@ int pixy2_protocol_transceive(struct pixy2_transport *t,
 			      struct pixy2_message *req,
 			      struct pixy2_message *reply);
 
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+/**
+ * @brief Submit a request without waiting for its reply.
+ *
+ * Asynchronous counterpart of @ref pixy2_protocol_transceive. The reply
+ * is collected and validated using @ref pixy2_protocol_complete. See
+ * @ref pixy2_transport_submit for the lifetime requirements.
+ *
+ * @param t pointer to the generic transport layer data
+ * @param req pointer to the request data
+ * @param reply pointer to the reply data
+ *
+ * @retval 0 if success
+ * @retval negative errno code if error
+ */
+int pixy2_protocol_submit(struct pixy2_transport *t,
+			  struct pixy2_message *req,
+			  struct pixy2_message *reply);
+
+/**
+ * @brief Collect and validate the reply of a submitted request.
+ *
+ * Failed requests are submitted again in the same way as
+ * @ref pixy2_protocol_transceive retries them. If @p wait is false, the
+ * call then returns -EAGAIN.
+ *
+ * @param t pointer to the generic transport layer data
+ * @param req pointer to the request data passed to @ref pixy2_protocol_submit
+ * @param reply pointer to the reply data passed to @ref pixy2_protocol_submit
+ * @param wait true if the call should block until the reply is received
+ *
+ * @retval 0 if success
+ * @retval -EAGAIN if @p wait is false and the reply is not received yet
+ * @retval negative errno code if error
+ */
+int pixy2_protocol_complete(struct pixy2_transport *t,
+			    struct pixy2_message *req,
+			    struct pixy2_message *reply,
+			    bool wait);
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
+
 #endif /* _PIXY2_PROTOCOL_H_ */
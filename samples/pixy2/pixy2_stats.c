@@ -0,0 +1,174 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/shell/shell.h>
+
+#include "pixy2_stats.h"
+
+/* all statistics ever registered */
+static sys_slist_t pixy2_stats_list = SYS_SLIST_STATIC_INIT(&pixy2_stats_list);
+static struct k_spinlock pixy2_stats_list_lock;
+
+static const char *const pixy2_stats_phase_names[] = {
+	[PIXY2_STATS_SEND] = "send",
+	[PIXY2_STATS_SYNC] = "sync",
+	[PIXY2_STATS_RECV] = "recv",
+	[PIXY2_STATS_TOTAL] = "total",
+};
+
+BUILD_ASSERT(ARRAY_SIZE(pixy2_stats_phase_names) == PIXY2_STATS_NUM_PHASES);
+
+static void pixy2_histogram_record(struct pixy2_histogram *h, uint64_t cycles)
+{
+	int bucket;
+
+	/* bucket i holds the samples in [2^i, 2^(i + 1)), 0 goes into bucket 0 */
+	bucket = cycles ? 63 - __builtin_clzll(cycles) : 0;
+	bucket = MIN(bucket, PIXY2_STATS_NUM_BUCKETS - 1);
+
+	h->buckets[bucket]++;
+	h->sum += cycles;
+
+	if (!h->count || cycles < h->min) {
+		h->min = cycles;
+	}
+
+	if (cycles > h->max) {
+		h->max = cycles;
+	}
+
+	h->count++;
+}
+
+void pixy2_stats_begin(struct pixy2_stats *s, const char *name)
+{
+	k_spinlock_key_t key;
+
+	if (!s->registered) {
+		key = k_spin_lock(&pixy2_stats_list_lock);
+
+		s->name = name;
+		s->registered = true;
+		sys_slist_append(&pixy2_stats_list, &s->node);
+
+		k_spin_unlock(&pixy2_stats_list_lock, key);
+	}
+
+	s->start = k_cycle_get_64();
+	s->last = s->start;
+}
+
+void pixy2_stats_mark(struct pixy2_stats *s, enum pixy2_stats_phase phase)
+{
+	uint64_t now;
+	k_spinlock_key_t key;
+
+	now = k_cycle_get_64();
+
+	key = k_spin_lock(&s->lock);
+	pixy2_histogram_record(&s->phases[phase], now - s->last);
+	k_spin_unlock(&s->lock, key);
+
+	s->last = now;
+}
+
+void pixy2_stats_end(struct pixy2_stats *s)
+{
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&s->lock);
+	pixy2_histogram_record(&s->phases[PIXY2_STATS_TOTAL],
+			       k_cycle_get_64() - s->start);
+	k_spin_unlock(&s->lock, key);
+}
+
+static void pixy2_histogram_print(const struct shell *sh, const char *name,
+				  const struct pixy2_histogram *h)
+{
+	int i;
+
+	if (!h->count) {
+		shell_print(sh, "  %s: no samples", name);
+		return;
+	}
+
+	shell_print(sh, "  %s: %u samples, min %llu ns, avg %llu ns, max %llu ns",
+		    name, h->count,
+		    (unsigned long long)k_cyc_to_ns_floor64(h->min),
+		    (unsigned long long)k_cyc_to_ns_floor64(h->sum / h->count),
+		    (unsigned long long)k_cyc_to_ns_floor64(h->max));
+
+	for (i = 0; i < PIXY2_STATS_NUM_BUCKETS; i++) {
+		if (!h->buckets[i]) {
+			continue;
+		}
+
+		shell_print(sh, "    [%llu, %llu) ns: %u",
+			    (unsigned long long)k_cyc_to_ns_floor64(i ? BIT64(i) : 0),
+			    (unsigned long long)k_cyc_to_ns_floor64(BIT64(i + 1)),
+			    h->buckets[i]);
+	}
+}
+
+static int cmd_pixy2_stats(const struct shell *sh, size_t argc, char **argv)
+{
+	int i;
+	struct pixy2_stats *s;
+	k_spinlock_key_t key;
+	struct pixy2_histogram phases[PIXY2_STATS_NUM_PHASES];
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&pixy2_stats_list, s, node) {
+		/* take a consistent snapshot, printing is slow */
+		key = k_spin_lock(&s->lock);
+		memcpy(phases, s->phases, sizeof(phases));
+		k_spin_unlock(&s->lock, key);
+
+		shell_print(sh, "%s:", s->name);
+
+		for (i = 0; i < PIXY2_STATS_NUM_PHASES; i++) {
+			pixy2_histogram_print(sh, pixy2_stats_phase_names[i],
+					      &phases[i]);
+		}
+	}
+
+	return 0;
+}
+
+static int cmd_pixy2_stats_reset(const struct shell *sh, size_t argc,
+				 char **argv)
+{
+	struct pixy2_stats *s;
+	k_spinlock_key_t key;
+
+	ARG_UNUSED(sh);
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&pixy2_stats_list, s, node) {
+		key = k_spin_lock(&s->lock);
+		memset(s->phases, 0, sizeof(s->phases));
+		k_spin_unlock(&s->lock, key);
+	}
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_pixy2_stats,
+	SHELL_CMD(reset, NULL, "Reset the latency histograms",
+		  cmd_pixy2_stats_reset),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_pixy2,
+	SHELL_CMD(stats, &sub_pixy2_stats,
+		  "Print the transport latency histograms", cmd_pixy2_stats),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(pixy2, &sub_pixy2, "Pixy2 camera commands", NULL);
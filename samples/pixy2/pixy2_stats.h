@@ -0,0 +1,130 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file pixy2_stats.h
+ * @brief Pixy2 transport layer latency statistics
+ *
+ * This file offers the API used by the transport layer for recording how
+ * long each phase of a request/reply pair takes. The latencies are measured
+ * using the 64-bit cycle counter and accumulated in log2-scale histograms,
+ * one per phase, which can be printed using the "pixy2 stats" shell command.
+ *
+ * The phases of a request/reply pair are:
+ *
+ * 1. send: time spent delivering the request.
+ * 2. sync: time spent waiting for the reply header.
+ * 3. recv: time spent receiving the reply payload.
+ * 4. total: time spent in pixy2_transport_transceive() or, with RTIO,
+ *    between pixy2_transport_submit() and pixy2_transport_complete().
+ *
+ * Transports unable to tell some of the phases apart (e.g. the combined
+ * I2C transport or RTIO) only record the phases they can measure.
+ *
+ * Use the PIXY2_STATS_* macros instead of calling the functions directly.
+ * With CONFIG_NXPCUP_PIXY2_TRANSPORT_STATS disabled, they expand to nothing.
+ */
+
+#ifndef _PIXY2_STATS_H_
+#define _PIXY2_STATS_H_
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/slist.h>
+
+/** number of histogram buckets - bucket i counts latencies in [2^i, 2^(i + 1)) */
+#define PIXY2_STATS_NUM_BUCKETS	32
+
+/**
+ * @enum pixy2_stats_phase
+ * @brief Request/reply phases
+ */
+enum pixy2_stats_phase {
+	PIXY2_STATS_SEND = 0,
+	PIXY2_STATS_SYNC,
+	PIXY2_STATS_RECV,
+	PIXY2_STATS_TOTAL,
+	PIXY2_STATS_NUM_PHASES,
+};
+
+/**
+ * @struct pixy2_histogram
+ * @brief Latency histogram of a phase
+ */
+struct pixy2_histogram {
+	/** number of samples in each bucket */
+	uint32_t buckets[PIXY2_STATS_NUM_BUCKETS];
+	/** total number of samples */
+	uint32_t count;
+	/** sum of all samples (cycles) */
+	uint64_t sum;
+	/** smallest sample (cycles) */
+	uint64_t min;
+	/** largest sample (cycles) */
+	uint64_t max;
+};
+
+/**
+ * @struct pixy2_stats
+ * @brief Latency statistics of a transport
+ */
+struct pixy2_stats {
+	/** histograms, one per phase */
+	struct pixy2_histogram phases[PIXY2_STATS_NUM_PHASES];
+	/** cycle count at the beginning of the current request/reply pair */
+	uint64_t start;
+	/** cycle count at the end of the last recorded phase */
+	uint64_t last;
+	/** name printed by the shell command */
+	const char *name;
+	/** node used for linking the statistics into the global list */
+	sys_snode_t node;
+	/** true if the statistics were linked into the global list */
+	bool registered;
+	/** protects the histograms against concurrent printing/resetting */
+	struct k_spinlock lock;
+};
+
+/**
+ * @brief Mark the beginning of a request/reply pair
+ *
+ * The first call also registers the statistics with the shell command.
+ *
+ * @param s pointer to the statistics
+ * @param name name used when printing the statistics
+ */
+void pixy2_stats_begin(struct pixy2_stats *s, const char *name);
+
+/**
+ * @brief Record the time elapsed since the last recorded phase
+ *
+ * @param s pointer to the statistics
+ * @param phase phase which has just ended
+ */
+void pixy2_stats_mark(struct pixy2_stats *s, enum pixy2_stats_phase phase);
+
+/**
+ * @brief Record the time elapsed since the beginning of the request/reply pair
+ *
+ * @param s pointer to the statistics
+ */
+void pixy2_stats_end(struct pixy2_stats *s);
+
+#ifdef CONFIG_NXPCUP_PIXY2_TRANSPORT_STATS
+#define PIXY2_STATS_BEGIN(t)\
+	pixy2_stats_begin(&(t)->stats, pixy2_transport_name(t))
+
+#define PIXY2_STATS_MARK(t, phase)\
+	pixy2_stats_mark(&(t)->stats, phase)
+
+#define PIXY2_STATS_END(t)\
+	pixy2_stats_end(&(t)->stats)
+#else
+#define PIXY2_STATS_BEGIN(t)
+#define PIXY2_STATS_MARK(t, phase)
+#define PIXY2_STATS_END(t)
+#endif /* CONFIG_NXPCUP_PIXY2_TRANSPORT_STATS */
+
+#endif /* _PIXY2_STATS_H_ */
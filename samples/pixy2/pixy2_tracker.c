@@ -0,0 +1,83 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "pixy2_tracker.h"
+
+static struct pixy2_track *pixy2_tracker_alloc(struct pixy2_tracker *tr,
+					       uint8_t index)
+{
+	int i;
+
+	for (i = 0; i < PIXY2_TRACKER_MAX_TRACKS; i++) {
+		if (!tr->tracks[i].valid) {
+			tr->slots[index] = i + 1;
+			tr->tracks[i].valid = true;
+			return &tr->tracks[i];
+		}
+	}
+
+	return NULL;
+}
+
+int pixy2_tracker_update(struct pixy2_tracker *tr, const struct pixy2_blocks *b)
+{
+	int i, dropped;
+	struct pixy2_track *track;
+	const struct pixy2_block *block;
+	bool seen[PIXY2_TRACKER_MAX_TRACKS] = { 0 };
+
+	dropped = 0;
+
+	for (i = 0; i < b->num_blocks; i++) {
+		block = &b->blocks[i];
+
+		if (tr->slots[block->index]) {
+			track = &tr->tracks[tr->slots[block->index] - 1];
+
+			/*
+			 * age going backwards means the camera lost the
+			 * previous object and re-used its index.
+			 */
+			if (block->age < track->block.age) {
+				track->dx = 0;
+				track->dy = 0;
+			} else {
+				track->dx = block->x - track->block.x;
+				track->dy = block->y - track->block.y;
+			}
+		} else {
+			track = pixy2_tracker_alloc(tr, block->index);
+			if (!track) {
+				dropped++;
+				continue;
+			}
+
+			track->dx = 0;
+			track->dy = 0;
+		}
+
+		track->block = *block;
+		track->missed = 0;
+
+		seen[tr->slots[block->index] - 1] = true;
+	}
+
+	/* age the tracks that weren't part of this frame */
+	for (i = 0; i < PIXY2_TRACKER_MAX_TRACKS; i++) {
+		track = &tr->tracks[i];
+
+		if (!track->valid || seen[i]) {
+			continue;
+		}
+
+		if (++track->missed > tr->max_missed) {
+			tr->slots[track->block.index] = 0;
+			track->valid = false;
+		}
+	}
+
+	return dropped;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file pixy2_tracker.h
+ * @brief Pixy2 block tracker API
+ *
+ * This file offers a frame-to-frame tracker for the blocks returned by
+ * the getBlocks() command. Blocks are matched across frames using the
+ * tracking index assigned by the camera, while the age field is used for
+ * detecting the camera re-using an index for a different object.
+ *
+ * The tracker has a fixed capacity and never allocates. Updating it takes
+ * bounded time: one table lookup per block plus one pass over the tracks.
+ */
+
+#ifndef _PIXY2_TRACKER_H_
+#define _PIXY2_TRACKER_H_
+
+#include "pixy2_command.h"
+
+/** maximum number of objects tracked at the same time */
+#define PIXY2_TRACKER_MAX_TRACKS	PIXY2_MAX_BLOCKS
+
+/**
+ * @struct pixy2_track
+ * @brief Object tracked across frames
+ */
+struct pixy2_track {
+	/** block from the most recent frame the object was seen in */
+	struct pixy2_block block;
+	/** x displacement since the previous sighting (in pixels) */
+	int16_t dx;
+	/** y displacement since the previous sighting (in pixels) */
+	int16_t dy;
+	/** number of consecutive frames the object was not seen in */
+	uint8_t missed;
+	/** true if the track is in use */
+	bool valid;
+};
+
+/**
+ * @struct pixy2_tracker
+ * @brief Pixy2 block tracker
+ */
+struct pixy2_tracker {
+	/** tracks */
+	struct pixy2_track tracks[PIXY2_TRACKER_MAX_TRACKS];
+	/** maps a tracking index to its track (slot + 1), 0 if not tracked */
+	uint8_t slots[UINT8_MAX + 1];
+	/** frames an object may go unseen for before its track is dropped */
+	uint8_t max_missed;
+};
+
+/**
+ * @brief Prepare a pixy2_tracker structure
+ *
+ * @param m frames an object may go unseen for before being dropped
+ */
+#define PIXY2_TRACKER(m)	\
+{				\
+	.max_missed = m,	\
+}
+
+/**
+ * @brief Update the tracker with the blocks of a new frame
+ *
+ * @param tr pointer to the tracker
+ * @param b pointer to the blocks received for the new frame
+ *
+ * @retval number of blocks that could not be tracked (tracker full)
+ */
+int pixy2_tracker_update(struct pixy2_tracker *tr, const struct pixy2_blocks *b);
+
+/**
+ * @brief Find the track of an object
+ *
+ * @param tr pointer to the tracker
+ * @param index tracking index of the object
+ *
+ * @retval pointer to the track
+ * @retval NULL if the object is not tracked
+ */
+static inline const struct pixy2_track *
+pixy2_tracker_find(const struct pixy2_tracker *tr, uint8_t index)
+{
+	if (!tr->slots[index]) {
+		return NULL;
+	}
+
+	return &tr->tracks[tr->slots[index] - 1];
+}
+
+#endif /* _PIXY2_TRACKER_H_ */
@@ -16,6 +16,14 @@
 #define _PIXY2_TRANSPORT_H_
 
 #include <zephyr/device.h>
+#include <zephyr/drivers/spi.h>
+
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/rtio/rtio.h>
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
+
+#include "pixy2_stats.h"
 
 /**
  * @struct pixy2_checksum_header
@@ -57,6 +65,59 @@ struct pixy2_header {
 	uint8_t len;
 } __packed;
 
+/**
+ * @brief Length of the header sent along with a request
+ *
+ * Requests only carry a checksum if checksum verification is enabled.
+ *
+ * @param req pointer to the request data
+ */
+#define PIXY2_REQUEST_HEADER_LEN(req)					\
+	((req)->checksum ? sizeof(struct pixy2_checksum_header) :	\
+	 sizeof(struct pixy2_header))
+
+/** maximum payload length of a Pixy2 message */
+#define PIXY2_MAX_PAYLOAD_LEN	UINT8_MAX
+
+/** number of bytes needed for flushing a partial request or reply */
+#define PIXY2_FLUSH_LEN		(sizeof(struct pixy2_checksum_header) +	\
+				 PIXY2_MAX_PAYLOAD_LEN)
+
+/** time given to the camera to answer the request completed by a flush */
+#define PIXY2_RECOVERY_DELAY_US	1000
+
+/** value clocked out by the camera when it has nothing to send (SPI) */
+#define PIXY2_SPI_IDLE_BYTE	0x1
+
+/*
+ * number of bytes clocked in at once while looking for the reply header
+ * (SPI). If the camera answers right away, the window also holds the first
+ * bytes of the payload, so short replies need no further transfer.
+ */
+#define PIXY2_SPI_WINDOW_LEN	24
+
+/** number of windows clocked in before giving up on the reply header (SPI) */
+#define PIXY2_SPI_TIMEOUT_WINDOWS	4
+
+/*
+ * replies carrying at most this many payload bytes are read along with
+ * their header (I2C).
+ */
+#define PIXY2_I2C_SPECULATIVE_PAYLOAD_LEN	16
+
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+/**
+ * @enum pixy2_transport_stage
+ * @brief Stage reached by the submission currently in flight
+ */
+enum pixy2_transport_stage {
+	/** request sent, reading the reply header */
+	PIXY2_TRANSPORT_STAGE_HEADER,
+	/** reply header checked, reading the rest of the reply payload */
+	PIXY2_TRANSPORT_STAGE_PAYLOAD,
+};
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
+
 /*
  * @struct pixy2_message
  * @brief Pixy2 message
@@ -68,6 +129,8 @@ struct pixy2_message {
 	struct pixy2_checksum_header hdr;
 	/** true if checksum verification is enabled, false otherwise */
 	bool checksum;
+	/** minimum payload length of the expected reply (replies only) */
+	uint8_t min_len;
 	/** payload data */
 	uint8_t *payload;
 };
@@ -85,6 +148,34 @@ struct pixy2_transport {
 	const struct device *ctlr;
 	/* transport API */
 	const struct pixy2_transport_api *api;
+	/** bus clock rate (in Hz), 0 if left to the transport's default */
+	uint32_t rate;
+	/** name telling the cameras apart, the controller's name if NULL */
+	const char *name;
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+	/** RTIO context used for submitting the transfers (not shared) */
+	struct rtio *r;
+	/** RTIO device wrapping the peripheral controller */
+	struct rtio_iodev iodev;
+	/** reply of the request currently in flight, NULL if none */
+	struct pixy2_message *pending;
+	/** status of the request currently in flight */
+	int result;
+	/** reply header expected by the request in flight, restored on retry */
+	struct pixy2_checksum_header expected;
+	/** number of times the request in flight was retried */
+	uint8_t retries;
+	/** stage reached by the request in flight */
+	enum pixy2_transport_stage stage;
+	/** maximum payload length of the reply currently in flight */
+	uint8_t reply_len;
+	/** expected type of the reply currently in flight */
+	uint8_t reply_type;
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
+#ifdef CONFIG_NXPCUP_PIXY2_TRANSPORT_STATS
+	/** latency statistics */
+	struct pixy2_stats stats;
+#endif /* CONFIG_NXPCUP_PIXY2_TRANSPORT_STATS */
 };
 
 /**
@@ -98,6 +189,12 @@ struct pixy2_i2c_transport {
 	struct pixy2_transport t;
 	/** I2C address of the Pixy2 camera */
 	const uint32_t address;
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+	/** bus specification used by the RTIO device */
+	struct i2c_dt_spec spec;
+	/** number of payload bytes read along with the reply header */
+	uint8_t chunk_len;
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
 };
 
 /**
@@ -111,6 +208,18 @@ struct pixy2_spi_transport {
 	struct pixy2_transport t;
 	/** SPI slave index */
 	const uint32_t sidx;
+	/** bus specifications, the one in use is built on first use */
+	struct spi_dt_spec specs[2];
+	/** bus specification in use, NULL until first use */
+	struct spi_dt_spec *spec;
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+	/** window in which the reply header is looked for */
+	uint8_t window[PIXY2_SPI_WINDOW_LEN];
+	/** number of valid bytes in the window */
+	uint8_t window_len;
+	/** number of windows clocked in while looking for the reply header */
+	uint8_t windows;
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
 };
 
 /**
@@ -123,8 +232,34 @@ struct pixy2_transport_api {
 	int (*transceive)(struct pixy2_transport *t,
 			  struct pixy2_message *req,
 			  struct pixy2_message *reply);
+	int (*recover)(struct pixy2_transport *t);
+	int (*set_rate)(struct pixy2_transport *t, uint32_t rate);
+	/** bus clock rates (in Hz) worth trying, in increasing order */
+	const uint32_t *rates;
+	/** number of entries in @ref rates */
+	size_t num_rates;
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+	int (*submit)(struct pixy2_transport *t,
+		      struct pixy2_message *req,
+		      struct pixy2_message *reply);
+	int (*complete)(struct pixy2_transport *t, bool wait);
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
 };
 
+/**
+ * @brief Get the name of a transport
+ *
+ * Used for telling the cameras apart in logs, statistics and thread names.
+ *
+ * @param t pointer to the generic transport layer data
+ *
+ * @return @ref pixy2_transport::name if set, the controller's name otherwise
+ */
+static inline const char *pixy2_transport_name(const struct pixy2_transport *t)
+{
+	return t->name ? t->name : t->ctlr->name;
+}
+
 /**
  * @brief Send a request and wait for its reply
  *
@@ -136,26 +271,264 @@ struct pixy2_transport_api {
  * @param reply pointer to the reply data
  *
  * @retval 0 if success
+ * @retval -EBUSY if a submission is in flight (RTIO only)
  * @retval negative errno code if error
  */
 static inline int pixy2_transport_transceive(struct pixy2_transport *t,
 					     struct pixy2_message *req,
 					     struct pixy2_message *reply)
 {
+	int ret;
+
 	/* sanity checks */
 	if (!t || !t->ctlr || !t->api->transceive) {
 		return -EINVAL;
 	}
 
-	return t->api->transceive(t, req, reply);
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+	/* the transfers would share the RTIO context with the submission */
+	if (t->pending) {
+		return -EBUSY;
+	}
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
+
+	PIXY2_STATS_BEGIN(t);
+
+	ret = t->api->transceive(t, req, reply);
+
+	PIXY2_STATS_END(t);
+
+	return ret;
+}
+
+/**
+ * @brief Bring the camera back to a clean request/reply state
+ *
+ * This function is used to resynchronise with a camera left in the middle
+ * of a transaction (e.g. after a warm restart of the board or a glitch on
+ * the bus). Any partial request is completed, the bus is recovered (if
+ * supported) and any pending reply is drained. Takes a few milliseconds,
+ * most of which are spent sleeping while the camera answers the completed
+ * request.
+ *
+ * @param t pointer to the generic transport layer data
+ *
+ * @retval 0 if success
+ * @retval -ENOTSUP if the transport doesn't support recovery
+ * @retval negative errno code if error
+ */
+static inline int pixy2_transport_recover(struct pixy2_transport *t)
+{
+	/* sanity checks */
+	if (!t || !t->ctlr) {
+		return -EINVAL;
+	}
+
+	if (!t->api->recover) {
+		return -ENOTSUP;
+	}
+
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+	if (t->pending) {
+		return -EBUSY;
+	}
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
+
+	return t->api->recover(t);
 }
 
+/**
+ * @brief Change the bus clock rate
+ *
+ * The new rate is used starting with the next transfer and is stored in
+ * @ref pixy2_transport::rate.
+ *
+ * @param t pointer to the generic transport layer data
+ * @param rate bus clock rate (in Hz)
+ *
+ * @retval 0 if success
+ * @retval -ENOTSUP if the transport doesn't support changing the rate
+ * @retval negative errno code if error
+ */
+static inline int pixy2_transport_set_rate(struct pixy2_transport *t,
+					   uint32_t rate)
+{
+	/* sanity checks */
+	if (!t || !t->ctlr) {
+		return -EINVAL;
+	}
+
+	if (!t->api->set_rate) {
+		return -ENOTSUP;
+	}
+
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+	if (t->pending) {
+		return -EBUSY;
+	}
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
+
+	return t->api->set_rate(t, rate);
+}
+
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+/**
+ * @brief Submit a request without waiting for its reply
+ *
+ * This function is used to queue a request to the Pixy2 camera and
+ * the read of its reply header as a single chained RTIO submission. The
+ * call returns as soon as the transfers have been queued. The reply is
+ * collected using @ref pixy2_transport_complete, which queues the read
+ * of the rest of the reply (if any) once the header has been checked.
+ *
+ * @p req and @p reply need to remain valid until the submission is
+ * completed. Only one submission may be in flight per transport.
+ *
+ * @param t pointer to the generic transport layer data
+ * @param req pointer to the request data
+ * @param reply pointer to the reply data
+ *
+ * @retval 0 if success
+ * @retval -EBUSY if a submission is already in flight
+ * @retval negative errno code if error
+ */
+static inline int pixy2_transport_submit(struct pixy2_transport *t,
+					 struct pixy2_message *req,
+					 struct pixy2_message *reply)
+{
+	/* sanity checks */
+	if (!t || !t->ctlr || !t->r || !t->api->submit) {
+		return -EINVAL;
+	}
+
+	if (t->pending) {
+		return -EBUSY;
+	}
+
+	PIXY2_STATS_BEGIN(t);
+
+	return t->api->submit(t, req, reply);
+}
+
+/**
+ * @brief Collect the reply of a previously submitted request
+ *
+ * A reply might take more than one round of transfers (e.g. a reply
+ * header clocked in after a few idle windows, a long payload). If @p wait
+ * is false, each call consumes the transfers done so far, queues the next
+ * ones and returns -EAGAIN until the whole reply has been read.
+ *
+ * @param t pointer to the generic transport layer data
+ * @param wait true if the call should block until the submission
+ * is completed, false otherwise
+ *
+ * @retval 0 if success
+ * @retval -EAGAIN if @p wait is false and the submission is not done yet
+ * @retval negative errno code if error
+ */
+static inline int pixy2_transport_complete(struct pixy2_transport *t,
+					   bool wait)
+{
+	int ret;
+
+	/* sanity checks */
+	if (!t || !t->pending || !t->api->complete) {
+		return -EINVAL;
+	}
+
+	ret = t->api->complete(t, wait);
+	if (ret != -EAGAIN) {
+		PIXY2_STATS_END(t);
+	}
+
+	return ret;
+}
+
+/**
+ * @brief Consume the completions of the submission currently in flight
+ *
+ * Helper used by the transport layer drivers. The last submission queue
+ * entry of a submission is expected to carry the pending reply as user data.
+ *
+ * @param t pointer to the generic transport layer data
+ * @param wait true if the call should block until all completions arrive
+ *
+ * @retval 0 if all transfers were successful
+ * @retval -EAGAIN if @p wait is false and the submission is not done yet
+ * @retval negative errno code of the first failed transfer otherwise
+ */
+static inline int pixy2_transport_rtio_reap(struct pixy2_transport *t,
+					    bool wait)
+{
+	bool last;
+	struct rtio_cqe *cqe;
+
+	do {
+		cqe = wait ? rtio_cqe_consume_block(t->r) : rtio_cqe_consume(t->r);
+		if (!cqe) {
+			return -EAGAIN;
+		}
+
+		/* keep the first error, the rest are cancellations */
+		if (cqe->result < 0 && !t->result) {
+			t->result = cqe->result;
+		}
+
+		last = cqe->userdata == t->pending;
+
+		rtio_cqe_release(t->r, cqe);
+	} while (!last);
+
+	return t->result;
+}
+
+/**
+ * @brief Queue the next read of the reply currently in flight
+ *
+ * Helper used by the transport layer drivers once the completions of the
+ * previous transfers have been consumed.
+ *
+ * @param t pointer to the generic transport layer data
+ * @param buf buffer receiving the data
+ * @param len number of bytes to read
+ * @param iodev_flags RTIO device specific flags (e.g. RTIO_IODEV_I2C_STOP)
+ *
+ * @retval 0 if success
+ * @retval negative errno code if error
+ */
+static inline int pixy2_transport_rtio_read(struct pixy2_transport *t,
+					    uint8_t *buf, uint32_t len,
+					    uint16_t iodev_flags)
+{
+	struct rtio_sqe *sqe;
+
+	sqe = rtio_sqe_acquire(t->r);
+	if (!sqe) {
+		return -ENOMEM;
+	}
+
+	rtio_sqe_prep_read(sqe, &t->iodev, RTIO_PRIO_NORM, buf, len, t->pending);
+	sqe->iodev_flags |= iodev_flags;
+
+	t->result = 0;
+
+	return rtio_submit(t->r, 0);
+}
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
+
 #ifdef CONFIG_NXPCUP_PIXY2_SPI_TRANSPORT
 extern const struct pixy2_transport_api pixy2_transport_spi_api;
 #endif /* CONFIG_PIXY2_SPI_TRANSPORT */
 
 #ifdef CONFIG_NXPCUP_PIXY2_I2C_TRANSPORT
 extern const struct pixy2_transport_api pixy2_transport_i2c_api;
+#ifndef CONFIG_NXPCUP_PIXY2_RTIO
+/*
+ * I2C transport issuing the request and (most of) its reply as a single
+ * combined transaction via i2c_transfer().
+ */
+extern const struct pixy2_transport_api pixy2_transport_i2c_xfer_api;
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
 #endif /* CONFIG_PIXY2_I2C_TRANSPORT */
 
 #endif /* _PIXY2_TRANSPORT_H_ */
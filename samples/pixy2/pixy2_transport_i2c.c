@@ -5,9 +5,10 @@
  */
 
 #include <zephyr/drivers/i2c.h>
+#include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 
-#include "pixy2_transport.h"
+#include "pixy2_protocol.h"
 
 LOG_MODULE_REGISTER(pixy2_transport_i2c);
 
@@ -17,18 +18,85 @@ LOG_MODULE_REGISTER(pixy2_transport_i2c);
 #define pixy2_i2c_recv(i2c_t, b, l)\
 	i2c_read((i2c_t)->t.ctlr, (uint8_t *)b, l, (i2c_t)->address)
 
+/* bus speeds tried by the clock calibration, in increasing order */
+static const uint32_t pixy2_transport_i2c_rates[] = {
+	I2C_BITRATE_STANDARD, I2C_BITRATE_FAST, I2C_BITRATE_FAST_PLUS,
+};
+
+static int pixy2_transport_i2c_recover(struct pixy2_transport *t)
+{
+	int ret;
+	uint8_t buf[PIXY2_FLUSH_LEN];
+	struct pixy2_i2c_transport *i2c_t;
+
+	i2c_t = CONTAINER_OF(t, struct pixy2_i2c_transport, t);
+
+	/* release SDA in case the camera was left driving it */
+	ret = i2c_recover_bus(t->ctlr);
+	if (ret && ret != -ENOSYS) {
+		LOG_ERR("failed to recover bus: %d", ret);
+		return ret;
+	}
+
+	/*
+	 * the camera might be waiting for the rest of a request. Writing
+	 * enough zeros completes any partial request.
+	 */
+	memset(buf, 0, sizeof(buf));
+
+	ret = pixy2_i2c_send(i2c_t, buf, sizeof(buf));
+	if (ret) {
+		LOG_ERR("failed to flush camera: %d", ret);
+		return ret;
+	}
+
+	/* give the camera some time to answer the completed request */
+	k_sleep(K_USEC(PIXY2_RECOVERY_DELAY_US));
+
+	/* drain the answer along with what's left of any partial reply */
+	ret = pixy2_i2c_recv(i2c_t, buf, sizeof(buf));
+	if (ret) {
+		LOG_ERR("failed to drain camera: %d", ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+/* the speed applies to the whole bus, not just the camera */
+static int pixy2_transport_i2c_set_rate(struct pixy2_transport *t,
+					uint32_t rate)
+{
+	int ret;
+	uint32_t speed;
+
+	/* only the standard I2C speeds are supported */
+	speed = i2c_map_dt_bitrate(rate);
+	if (!speed) {
+		return -EINVAL;
+	}
+
+	ret = i2c_configure(t->ctlr, I2C_MODE_CONTROLLER | speed);
+	if (ret) {
+		LOG_ERR("failed to configure bus: %d", ret);
+		return ret;
+	}
+
+	t->rate = rate;
+
+	return 0;
+}
+
+#ifndef CONFIG_NXPCUP_PIXY2_RTIO
+
 static int pixy2_transport_i2c_recv(struct pixy2_i2c_transport *i2c_t,
 				    struct pixy2_message *reply)
 {
 	int ret;
-	uint8_t payload_len;
+	uint8_t payload_len, type;
 
 	payload_len = reply->hdr.len;
-
-	/* TODO: messages with checksum are currently not supported */
-	if (reply->checksum) {
-		return -ENOTSUP;
-	}
+	type = reply->hdr.type;
 
 	/* get the header */
 	ret = pixy2_i2c_recv(i2c_t, &reply->hdr, sizeof(reply->hdr));
@@ -37,11 +105,15 @@ static int pixy2_transport_i2c_recv(struct pixy2_i2c_transport *i2c_t,
 		return ret;
 	}
 
-	/* check if the payload will fit */
-	if (reply->hdr.len > payload_len) {
-		LOG_ERR("reply size (%d) exceeds allowed size (%d)",
-			reply->hdr.len, payload_len);
-		return -EINVAL;
+	PIXY2_STATS_MARK(&i2c_t->t, PIXY2_STATS_SYNC);
+
+	/* reject malformed replies before reading their payload */
+	ret = pixy2_protocol_check_header(&reply->hdr, type, reply->min_len,
+					  payload_len);
+	if (ret) {
+		LOG_ERR("invalid reply header (type 0x%x, size %d): %d",
+			reply->hdr.type, reply->hdr.len, ret);
+		return ret;
 	}
 
 	/* good to go, get the payload */
@@ -59,13 +131,8 @@ static int pixy2_transport_i2c_send(struct pixy2_i2c_transport *i2c_t,
 {
 	int ret;
 
-	/* TODO: messages with checksum are currently not supported */
-	if (req->checksum) {
-		return -ENOTSUP;
-	}
-
-	/* send the header with no checksum */
-	ret = pixy2_i2c_send(i2c_t, &req->hdr, sizeof(struct pixy2_header));
+	/* send the header */
+	ret = pixy2_i2c_send(i2c_t, &req->hdr, PIXY2_REQUEST_HEADER_LEN(req));
 	if (ret) {
 		LOG_ERR("failed to send message header: %d", ret);
 		return ret;
@@ -97,6 +164,8 @@ static int pixy2_transport_i2c_transceive(struct pixy2_transport *t,
 		return ret;
 	}
 
+	PIXY2_STATS_MARK(t, PIXY2_STATS_SEND);
+
 	/* get the reply */
 	ret = pixy2_transport_i2c_recv(i2c_t, reply);
 	if (ret) {
@@ -104,9 +173,288 @@ static int pixy2_transport_i2c_transceive(struct pixy2_transport *t,
 		return ret;
 	}
 
+	PIXY2_STATS_MARK(t, PIXY2_STATS_RECV);
+
+	return 0;
+}
+
+/* maximum number of messages making up a request/reply transaction */
+#define PIXY2_I2C_MAX_MSGS 4
+
+static int pixy2_transport_i2c_xfer_transceive(struct pixy2_transport *t,
+					       struct pixy2_message *req,
+					       struct pixy2_message *reply)
+{
+	int ret, num_msgs;
+	uint8_t payload_len, type, chunk_len;
+	struct pixy2_i2c_transport *i2c_t;
+	struct i2c_msg msgs[PIXY2_I2C_MAX_MSGS];
+
+	i2c_t = CONTAINER_OF(t, struct pixy2_i2c_transport, t);
+
+	payload_len = reply->hdr.len;
+	type = reply->hdr.type;
+	chunk_len = MIN(payload_len, PIXY2_I2C_SPECULATIVE_PAYLOAD_LEN);
+	num_msgs = 0;
+
+	/* the request header and payload are written back to back... */
+	msgs[num_msgs].buf = (uint8_t *)&req->hdr;
+	msgs[num_msgs].len = PIXY2_REQUEST_HEADER_LEN(req);
+	msgs[num_msgs++].flags = I2C_MSG_WRITE;
+
+	if (req->hdr.len) {
+		msgs[num_msgs].buf = req->payload;
+		msgs[num_msgs].len = req->hdr.len;
+		msgs[num_msgs++].flags = I2C_MSG_WRITE;
+	}
+
+	/* ...then, after a repeated start, the reply header is read... */
+	msgs[num_msgs].buf = (uint8_t *)&reply->hdr;
+	msgs[num_msgs].len = sizeof(reply->hdr);
+	msgs[num_msgs++].flags = I2C_MSG_READ | I2C_MSG_RESTART;
+
+	/* ...followed by the beginning of the payload */
+	if (chunk_len) {
+		msgs[num_msgs].buf = reply->payload;
+		msgs[num_msgs].len = chunk_len;
+		msgs[num_msgs++].flags = I2C_MSG_READ;
+	}
+
+	msgs[num_msgs - 1].flags |= I2C_MSG_STOP;
+
+	ret = i2c_transfer(t->ctlr, msgs, num_msgs, i2c_t->address);
+	if (ret) {
+		LOG_ERR("failed to transfer request/reply: %d", ret);
+		return ret;
+	}
+
+	/* the request can't be told apart from the wait for the reply header */
+	PIXY2_STATS_MARK(t, PIXY2_STATS_SYNC);
+
+	/* reject malformed replies before reading the rest of their payload */
+	ret = pixy2_protocol_check_header(&reply->hdr, type, reply->min_len,
+					  payload_len);
+	if (ret) {
+		LOG_ERR("invalid reply header (type 0x%x, size %d): %d",
+			reply->hdr.type, reply->hdr.len, ret);
+		return ret;
+	}
+
+	/* long reply, get the rest of the payload */
+	if (reply->hdr.len > chunk_len) {
+		ret = pixy2_i2c_recv(i2c_t, reply->payload + chunk_len,
+				     reply->hdr.len - chunk_len);
+		if (ret) {
+			LOG_ERR("failed to get reply payload: %d", ret);
+			return ret;
+		}
+	}
+
+	/* short replies were read along with their header, in no time */
+	PIXY2_STATS_MARK(t, PIXY2_STATS_RECV);
+
 	return 0;
 }
 
+const struct pixy2_transport_api pixy2_transport_i2c_xfer_api = {
+	.transceive = pixy2_transport_i2c_xfer_transceive,
+	.recover = pixy2_transport_i2c_recover,
+	.set_rate = pixy2_transport_i2c_set_rate,
+	.rates = pixy2_transport_i2c_rates,
+	.num_rates = ARRAY_SIZE(pixy2_transport_i2c_rates),
+};
+#else /* CONFIG_NXPCUP_PIXY2_RTIO */
+static void pixy2_transport_i2c_iodev_init(struct pixy2_i2c_transport *i2c_t)
+{
+	i2c_t->spec.bus = i2c_t->t.ctlr;
+	i2c_t->spec.addr = i2c_t->address;
+
+	i2c_t->t.iodev.api = &i2c_iodev_api;
+	i2c_t->t.iodev.data = &i2c_t->spec;
+}
+
+static int pixy2_transport_i2c_submit(struct pixy2_transport *t,
+				      struct pixy2_message *req,
+				      struct pixy2_message *reply)
+{
+	struct rtio_sqe *sqe;
+	struct pixy2_i2c_transport *i2c_t;
+
+	i2c_t = CONTAINER_OF(t, struct pixy2_i2c_transport, t);
+
+	if (!t->iodev.api) {
+		pixy2_transport_i2c_iodev_init(i2c_t);
+	}
+
+	sqe = rtio_sqe_acquire(t->r);
+	if (!sqe) {
+		return -ENOMEM;
+	}
+
+	rtio_sqe_prep_write(sqe, &t->iodev, RTIO_PRIO_NORM,
+			    (uint8_t *)&req->hdr, PIXY2_REQUEST_HEADER_LEN(req),
+			    NULL);
+
+	/* header and payload are written as a single bus transaction */
+	if (req->hdr.len) {
+		sqe->flags |= RTIO_SQE_TRANSACTION;
+
+		sqe = rtio_sqe_acquire(t->r);
+		if (!sqe) {
+			rtio_sqe_drop_all(t->r);
+			return -ENOMEM;
+		}
+
+		rtio_sqe_prep_write(sqe, &t->iodev, RTIO_PRIO_NORM,
+				    req->payload, req->hdr.len, NULL);
+	}
+
+	sqe->iodev_flags |= RTIO_IODEV_I2C_STOP;
+	sqe->flags |= RTIO_SQE_CHAINED;
+
+	/*
+	 * the reply is read as a single bus transaction as well: the header
+	 * lands directly in the reply header, followed by the beginning of
+	 * the payload. The rest of the payload, if any, is read once the
+	 * header has been checked.
+	 */
+	t->reply_len = reply->hdr.len;
+	t->reply_type = reply->hdr.type;
+	i2c_t->chunk_len = MIN(t->reply_len, PIXY2_I2C_SPECULATIVE_PAYLOAD_LEN);
+
+	sqe = rtio_sqe_acquire(t->r);
+	if (!sqe) {
+		rtio_sqe_drop_all(t->r);
+		return -ENOMEM;
+	}
+
+	rtio_sqe_prep_read(sqe, &t->iodev, RTIO_PRIO_NORM,
+			   (uint8_t *)&reply->hdr, sizeof(reply->hdr),
+			   i2c_t->chunk_len ? NULL : reply);
+
+	if (i2c_t->chunk_len) {
+		sqe->flags |= RTIO_SQE_TRANSACTION;
+
+		sqe = rtio_sqe_acquire(t->r);
+		if (!sqe) {
+			rtio_sqe_drop_all(t->r);
+			return -ENOMEM;
+		}
+
+		rtio_sqe_prep_read(sqe, &t->iodev, RTIO_PRIO_NORM,
+				   reply->payload, i2c_t->chunk_len, reply);
+	}
+
+	sqe->iodev_flags |= RTIO_IODEV_I2C_STOP;
+
+	t->pending = reply;
+	t->result = 0;
+	t->stage = PIXY2_TRANSPORT_STAGE_HEADER;
+
+	return rtio_submit(t->r, 0);
+}
+
+/*
+ * check the reply header and queue the read of the rest of the payload,
+ * if any. Returns -EINPROGRESS if the read was queued.
+ */
+static int pixy2_transport_i2c_header(struct pixy2_i2c_transport *i2c_t,
+				      struct pixy2_message *reply)
+{
+	int ret;
+	struct pixy2_transport *t = &i2c_t->t;
+
+	PIXY2_STATS_MARK(t, PIXY2_STATS_SYNC);
+
+	/* reject malformed replies before reading the rest of their payload */
+	ret = pixy2_protocol_check_header(&reply->hdr, t->reply_type,
+					  reply->min_len, t->reply_len);
+	if (ret) {
+		LOG_ERR("invalid reply header (type 0x%x, size %d): %d",
+			reply->hdr.type, reply->hdr.len, ret);
+		return ret;
+	}
+
+	if (reply->hdr.len <= i2c_t->chunk_len) {
+		return 0;
+	}
+
+	/* long reply, get the rest of the payload */
+	t->stage = PIXY2_TRANSPORT_STAGE_PAYLOAD;
+
+	ret = pixy2_transport_rtio_read(t, reply->payload + i2c_t->chunk_len,
+					reply->hdr.len - i2c_t->chunk_len,
+					RTIO_IODEV_I2C_STOP);
+	if (ret) {
+		LOG_ERR("failed to submit payload read: %d", ret);
+		return ret;
+	}
+
+	return -EINPROGRESS;
+}
+
+static int pixy2_transport_i2c_complete(struct pixy2_transport *t, bool wait)
+{
+	int ret;
+	struct pixy2_message *reply;
+	struct pixy2_i2c_transport *i2c_t;
+
+	i2c_t = CONTAINER_OF(t, struct pixy2_i2c_transport, t);
+	reply = t->pending;
+
+	do {
+		ret = pixy2_transport_rtio_reap(t, wait);
+		if (ret == -EAGAIN) {
+			return ret;
+		}
+
+		if (ret) {
+			LOG_ERR("failed to transceive: %d", ret);
+			break;
+		}
+
+		if (t->stage == PIXY2_TRANSPORT_STAGE_PAYLOAD) {
+			break;
+		}
+
+		ret = pixy2_transport_i2c_header(i2c_t, reply);
+	} while (ret == -EINPROGRESS);
+
+	/* short replies were read along with their header, in no time */
+	if (!ret) {
+		PIXY2_STATS_MARK(t, PIXY2_STATS_RECV);
+	}
+
+	t->pending = NULL;
+
+	return ret;
+}
+
+static int pixy2_transport_i2c_transceive(struct pixy2_transport *t,
+					  struct pixy2_message *req,
+					  struct pixy2_message *reply)
+{
+	int ret;
+
+	/* pixy2_transport_transceive() made sure nothing is in flight */
+	ret = pixy2_transport_i2c_submit(t, req, reply);
+	if (ret) {
+		LOG_ERR("failed to submit request: %d", ret);
+		return ret;
+	}
+
+	return pixy2_transport_i2c_complete(t, true);
+}
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
+
 const struct pixy2_transport_api pixy2_transport_i2c_api = {
 	.transceive = pixy2_transport_i2c_transceive,
+	.recover = pixy2_transport_i2c_recover,
+	.set_rate = pixy2_transport_i2c_set_rate,
+	.rates = pixy2_transport_i2c_rates,
+	.num_rates = ARRAY_SIZE(pixy2_transport_i2c_rates),
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+	.submit = pixy2_transport_i2c_submit,
+	.complete = pixy2_transport_i2c_complete,
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
 };
@@ -5,127 +5,192 @@
  */
 
 #include <zephyr/drivers/spi.h>
+#include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 
+#include "pixy2_protocol.h"
 #include "pixy2_transport.h"
 
 LOG_MODULE_REGISTER(pixy2_transport_spi);
 
-/* frequency of the SPI bus */
+/* frequency of the SPI bus, unless set using pixy2_transport_set_rate() */
 #define PIXY2_SPI_FREQUENCY	2000000
-/* nmber of words before timeout while waiting for SYNC0 */
-#define PIXY2_SPI_TIMEOUT_WORDS 10
-/* idle byte */
-#define PIXY2_SPI_IDLE_BYTE	0x1
 
-#define pixy2_spi_send(t, b, l)\
-	pixy2_transport_xfer_raw(t, b, l, NULL, 0)
+/* frequencies tried by the clock calibration, in increasing order */
+static const uint32_t pixy2_transport_spi_rates[] = {
+	1000000, 2000000, 3000000, 4000000, 6000000, 8000000,
+};
 
-#define pixy2_spi_recv(t, b, l)\
-	pixy2_transport_xfer_raw(t, NULL, 0, b, l)
+/* SPI bus configuration */
+#define PIXY2_SPI_OPERATION	(SPI_OP_MODE_MASTER | SPI_MODE_CPOL |	\
+				 SPI_MODE_CPHA | SPI_TRANSFER_MSB |	\
+				 SPI_WORD_SET(8))
 
-static int pixy2_transport_xfer_raw(struct pixy2_spi_transport *spi_t,
-				    void *tx_buf, size_t tx_len,
-				    void *rx_buf, size_t rx_len)
+/*
+ * find the SYNC0/SYNC1 pair marking the beginning of a reply header.
+ * Returns the offset of SYNC0 or -ENOENT if there's no such pair.
+ */
+static int pixy2_transport_spi_find_sync(const uint8_t *buf, size_t len)
 {
-	const struct spi_config spi_cfg = {
-		.operation = SPI_OP_MODE_MASTER | SPI_MODE_CPOL |
-			SPI_MODE_CPHA | SPI_TRANSFER_MSB | SPI_WORD_SET(8),
-		.frequency = PIXY2_SPI_FREQUENCY,
-		.slave = spi_t->sidx,
-	};
+	size_t i;
 
-	const struct spi_buf tx_buffer = {
-		.buf = tx_buf,
-		.len = tx_len,
-	};
+	for (i = 0; i + 1 < len; i++) {
+		if (buf[i] == PIXY2_REPLY_SYNC0 &&
+		    buf[i + 1] == PIXY2_REPLY_SYNC1) {
+			return i;
+		}
+	}
 
-	const struct spi_buf rx_buffer = {
-		.buf = rx_buf,
-		.len = rx_len,
-	};
+	return -ENOENT;
+}
+
+static void pixy2_transport_spi_config_init(struct pixy2_spi_transport *spi_t,
+					    uint32_t frequency)
+{
+	struct spi_dt_spec *spec;
+
+	/*
+	 * SPI drivers only reconfigure the bus if given a different
+	 * configuration than the previous transfer, so a new frequency
+	 * always goes into the configuration that is not in use.
+	 */
+	spec = spi_t->spec == &spi_t->specs[0] ?
+		&spi_t->specs[1] : &spi_t->specs[0];
+
+	spec->bus = spi_t->t.ctlr;
+	spec->config.operation = PIXY2_SPI_OPERATION;
+	spec->config.frequency = frequency;
+	spec->config.slave = spi_t->sidx;
+
+	spi_t->spec = spec;
+	spi_t->t.rate = frequency;
+
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+	spi_t->t.iodev.data = spec;
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
+}
 
+/* the rate may have been set before the first transfer */
+#define pixy2_spi_config_default(spi_t)					\
+	pixy2_transport_spi_config_init(spi_t, (spi_t)->t.rate ?	\
+					(spi_t)->t.rate : PIXY2_SPI_FREQUENCY)
+
+#define pixy2_spi_send(t, b, n)\
+	pixy2_transport_xfer_raw(t, b, n, NULL, 0)
+
+#define pixy2_spi_recv(t, b, n)\
+	pixy2_transport_xfer_raw(t, NULL, 0, b, n)
+
+static int pixy2_transport_xfer_raw(struct pixy2_spi_transport *spi_t,
+				    const struct spi_buf *tx_bufs, size_t tx_count,
+				    const struct spi_buf *rx_bufs, size_t rx_count)
+{
 	const struct spi_buf_set tx_buffer_set = {
-		.buffers = &tx_buffer,
-		.count = 1,
+		.buffers = tx_bufs,
+		.count = tx_count,
 	};
 
 	const struct spi_buf_set rx_buffer_set = {
-		.buffers = &rx_buffer,
-		.count = 1,
+		.buffers = rx_bufs,
+		.count = rx_count,
 	};
 
-	return spi_transceive(spi_t->t.ctlr, &spi_cfg,
-			      tx_len ? &tx_buffer_set : NULL,
-			      rx_len ? &rx_buffer_set : NULL);
+	return spi_transceive(spi_t->spec->bus, &spi_t->spec->config,
+			      tx_count ? &tx_buffer_set : NULL,
+			      rx_count ? &rx_buffer_set : NULL);
 }
 
-static int pixy2_transport_spi_wait_for_sync0(struct pixy2_spi_transport *spi_t,
-					      uint8_t *sync0)
+#ifndef CONFIG_NXPCUP_PIXY2_RTIO
+static int pixy2_transport_spi_recv(struct pixy2_spi_transport *spi_t,
+				    struct pixy2_message *reply)
 {
-	int ret, i;
-	uint8_t recv_byte;
-
-	recv_byte = PIXY2_SPI_IDLE_BYTE;
-
-	for (i = 0; (i < PIXY2_SPI_TIMEOUT_WORDS) &&
-	     (recv_byte == PIXY2_SPI_IDLE_BYTE); i++) {
+	int ret, i, offset;
+	uint8_t payload_len, type, window_len, carry, avail;
+	uint8_t window[PIXY2_SPI_WINDOW_LEN];
+	struct spi_buf rx_buffer;
 
-		ret = pixy2_spi_recv(spi_t, &recv_byte, sizeof(recv_byte));
+	payload_len = reply->hdr.len;
+	type = reply->hdr.type;
+	carry = 0;
+
+	/*
+	 * clock in whole windows and look for the SYNC0/SYNC1 pair in them.
+	 * Idle bytes and garbage left over from a previous transaction are
+	 * skipped. If the window ends with SYNC0, carry it into the next one
+	 * since SYNC1 might be the first byte of the next window.
+	 */
+	for (i = 0; i < PIXY2_SPI_TIMEOUT_WINDOWS; i++) {
+		rx_buffer.buf = &window[carry];
+		rx_buffer.len = sizeof(window) - carry;
+
+		ret = pixy2_spi_recv(spi_t, &rx_buffer, 1);
 		if (ret) {
-			LOG_ERR("failed to receive byte: %d", ret);
+			LOG_ERR("failed to receive reply window: %d", ret);
 			return ret;
 		}
+
+		offset = pixy2_transport_spi_find_sync(window, sizeof(window));
+		if (offset >= 0) {
+			break;
+		}
+
+		carry = window[sizeof(window) - 1] == PIXY2_REPLY_SYNC0;
+		if (carry) {
+			window[0] = PIXY2_REPLY_SYNC0;
+		}
 	}
 
-	if ((i == PIXY2_SPI_TIMEOUT_WORDS) &&
-	    (recv_byte == PIXY2_SPI_IDLE_BYTE)) {
+	if (i == PIXY2_SPI_TIMEOUT_WINDOWS) {
 		LOG_ERR("timeout while waiting for reply data");
 		return -ETIME;
 	}
 
-	*sync0 = recv_byte;
+	window_len = sizeof(window) - offset;
 
-	return 0;
-}
+	/* header might be cut by the end of the window, get the rest of it */
+	if (window_len < sizeof(reply->hdr)) {
+		memmove(window, &window[offset], window_len);
 
-static int pixy2_transport_spi_recv(struct pixy2_spi_transport *spi_t,
-				    struct pixy2_message *reply)
-{
-	int ret;
-	uint8_t payload_len;
+		rx_buffer.buf = &window[window_len];
+		rx_buffer.len = sizeof(reply->hdr) - window_len;
 
-	payload_len = reply->hdr.len;
+		ret = pixy2_spi_recv(spi_t, &rx_buffer, 1);
+		if (ret) {
+			LOG_ERR("failed to receive reply header: %d", ret);
+			return ret;
+		}
 
-	/* TODO: messages with checksum are currently not supported */
-	if (reply->checksum) {
-		return -ENOTSUP;
+		offset = 0;
+		window_len = sizeof(reply->hdr);
 	}
 
-	/* wait for SYNC0 byte */
-	ret = pixy2_transport_spi_wait_for_sync0(spi_t, &reply->hdr.sync0);
-	if (ret) {
-		LOG_ERR("failed to wait for SYNC0: %d", ret);
-		return ret;
-	}
+	memcpy(&reply->hdr, &window[offset], sizeof(reply->hdr));
+
+	PIXY2_STATS_MARK(&spi_t->t, PIXY2_STATS_SYNC);
 
-	/* get the rest of the reply header */
-	ret = pixy2_spi_recv(spi_t, &reply->hdr.sync1,
-			     sizeof(reply->hdr) - sizeof(reply->hdr.sync0));
+	/* reject malformed replies before clocking in the rest of their payload */
+	ret = pixy2_protocol_check_header(&reply->hdr, type, reply->min_len,
+					  payload_len);
 	if (ret) {
-		LOG_ERR("failed to receive reply header: %d", ret);
+		LOG_ERR("invalid reply header (type 0x%x, size %d): %d",
+			reply->hdr.type, reply->hdr.len, ret);
 		return ret;
 	}
 
-	/* check if the payload will fit */
-	if (reply->hdr.len > payload_len) {
-		LOG_ERR("reply size (%d) exceeds allowed size (%d)",
-			reply->hdr.len, payload_len);
-		return -EINVAL;
+	/* the bytes following the header are the beginning of the payload */
+	avail = MIN(window_len - sizeof(reply->hdr), reply->hdr.len);
+
+	memcpy(reply->payload, &window[offset + sizeof(reply->hdr)], avail);
+
+	if (reply->hdr.len == avail) {
+		return 0;
 	}
 
-	/* finally, get the payload */
-	ret = pixy2_spi_recv(spi_t, reply->payload, reply->hdr.len);
+	/* finally, get the rest of the payload */
+	rx_buffer.buf = reply->payload + avail;
+	rx_buffer.len = reply->hdr.len - avail;
+
+	ret = pixy2_spi_recv(spi_t, &rx_buffer, 1);
 	if (ret) {
 		LOG_ERR("failed to receive reply payload: %d", ret);
 		return ret;
@@ -138,23 +203,21 @@ static int pixy2_transport_spi_send(struct pixy2_spi_transport *spi_t,
 				    struct pixy2_message *req)
 {
 	int ret;
+	const struct spi_buf tx_buffers[] = {
+		{
+			.buf = &req->hdr,
+			.len = PIXY2_REQUEST_HEADER_LEN(req),
+		},
+		{
+			.buf = req->payload,
+			.len = req->hdr.len,
+		},
+	};
 
-	/* TODO: messages with checksum are currently not supported */
-	if (req->checksum) {
-		return -ENOTSUP;
-	}
-
-	/* send the header with no checksum */
-	ret = pixy2_spi_send(spi_t, &req->hdr, sizeof(struct pixy2_header));
-	if (ret) {
-		LOG_ERR("failed to send message header: %d", ret);
-		return ret;
-	}
-
-	/* send the payload */
-	ret = pixy2_spi_send(spi_t, req->payload, req->hdr.len);
+	/* header and payload go out in a single transaction */
+	ret = pixy2_spi_send(spi_t, tx_buffers, req->hdr.len ? 2 : 1);
 	if (ret) {
-		LOG_ERR("failed to send message payload: %d", ret);
+		LOG_ERR("failed to send message: %d", ret);
 		return ret;
 	}
 
@@ -170,6 +233,10 @@ static int pixy2_transport_spi_transceive(struct pixy2_transport *t,
 
 	spi_t = CONTAINER_OF(t, struct pixy2_spi_transport, t);
 
+	if (!spi_t->spec) {
+		pixy2_spi_config_default(spi_t);
+	}
+
 	/* send the request */
 	ret = pixy2_transport_spi_send(spi_t, req);
 	if (ret) {
@@ -177,6 +244,8 @@ static int pixy2_transport_spi_transceive(struct pixy2_transport *t,
 		return ret;
 	}
 
+	PIXY2_STATS_MARK(t, PIXY2_STATS_SEND);
+
 	/* get the reply */
 	ret = pixy2_transport_spi_recv(spi_t, reply);
 	if (ret) {
@@ -184,9 +253,329 @@ static int pixy2_transport_spi_transceive(struct pixy2_transport *t,
 		return ret;
 	}
 
+	PIXY2_STATS_MARK(t, PIXY2_STATS_RECV);
+
+	return 0;
+}
+#else /* CONFIG_NXPCUP_PIXY2_RTIO */
+static void pixy2_transport_spi_iodev_init(struct pixy2_spi_transport *spi_t)
+{
+	pixy2_spi_config_default(spi_t);
+
+	spi_t->t.iodev.api = &spi_iodev_api;
+}
+
+static int pixy2_transport_spi_submit(struct pixy2_transport *t,
+				      struct pixy2_message *req,
+				      struct pixy2_message *reply)
+{
+	struct rtio_sqe *sqe;
+	struct pixy2_spi_transport *spi_t;
+
+	spi_t = CONTAINER_OF(t, struct pixy2_spi_transport, t);
+
+	if (!t->iodev.api) {
+		pixy2_transport_spi_iodev_init(spi_t);
+	}
+
+	sqe = rtio_sqe_acquire(t->r);
+	if (!sqe) {
+		return -ENOMEM;
+	}
+
+	rtio_sqe_prep_write(sqe, &t->iodev, RTIO_PRIO_NORM,
+			    (uint8_t *)&req->hdr, PIXY2_REQUEST_HEADER_LEN(req),
+			    NULL);
+
+	/* header and payload go out in the same transaction... */
+	if (req->hdr.len) {
+		sqe->flags |= RTIO_SQE_TRANSACTION;
+
+		sqe = rtio_sqe_acquire(t->r);
+		if (!sqe) {
+			rtio_sqe_drop_all(t->r);
+			return -ENOMEM;
+		}
+
+		rtio_sqe_prep_write(sqe, &t->iodev, RTIO_PRIO_NORM,
+				    req->payload, req->hdr.len, NULL);
+	}
+
+	sqe->flags |= RTIO_SQE_CHAINED;
+
+	sqe = rtio_sqe_acquire(t->r);
+	if (!sqe) {
+		rtio_sqe_drop_all(t->r);
+		return -ENOMEM;
+	}
+
+	/*
+	 * ...followed by the first window in which the reply header is
+	 * looked for. The rest of the reply is read once the header has
+	 * been found and checked.
+	 */
+	t->reply_len = reply->hdr.len;
+	t->reply_type = reply->hdr.type;
+	spi_t->window_len = sizeof(spi_t->window);
+	spi_t->windows = 1;
+
+	rtio_sqe_prep_read(sqe, &t->iodev, RTIO_PRIO_NORM,
+			   spi_t->window, spi_t->window_len, reply);
+
+	t->pending = reply;
+	t->result = 0;
+	t->stage = PIXY2_TRANSPORT_STAGE_HEADER;
+
+	return rtio_submit(t->r, 0);
+}
+
+/* queue the read of len bytes into the window, starting at offset */
+static int pixy2_transport_spi_window_read(struct pixy2_spi_transport *spi_t,
+					   uint8_t offset, uint8_t len)
+{
+	int ret;
+
+	spi_t->window_len = offset + len;
+
+	ret = pixy2_transport_rtio_read(&spi_t->t, &spi_t->window[offset],
+					len, 0);
+	if (ret) {
+		LOG_ERR("failed to submit window read: %d", ret);
+		return ret;
+	}
+
+	return -EINPROGRESS;
+}
+
+/*
+ * look for the reply header in the window, the same way the blocking
+ * transport does. Queues the read of the next window, the rest of the
+ * header or the rest of the payload as needed, in which case -EINPROGRESS
+ * is returned.
+ */
+static int pixy2_transport_spi_header(struct pixy2_spi_transport *spi_t,
+				      struct pixy2_message *reply)
+{
+	int ret, offset;
+	uint8_t avail, carry;
+	struct pixy2_transport *t = &spi_t->t;
+
+	offset = pixy2_transport_spi_find_sync(spi_t->window, spi_t->window_len);
+	if (offset < 0) {
+		if (spi_t->windows == PIXY2_SPI_TIMEOUT_WINDOWS) {
+			LOG_ERR("timeout while waiting for reply data");
+			return -ETIME;
+		}
+
+		spi_t->windows++;
+
+		/* SYNC1 might be the first byte of the next window */
+		carry = spi_t->window[spi_t->window_len - 1] == PIXY2_REPLY_SYNC0;
+		if (carry) {
+			spi_t->window[0] = PIXY2_REPLY_SYNC0;
+		}
+
+		return pixy2_transport_spi_window_read(spi_t, carry,
+						       sizeof(spi_t->window) - carry);
+	}
+
+	avail = spi_t->window_len - offset;
+
+	/* header might be cut by the end of the window, get the rest of it */
+	if (avail < sizeof(reply->hdr)) {
+		memmove(spi_t->window, &spi_t->window[offset], avail);
+
+		return pixy2_transport_spi_window_read(spi_t, avail,
+						       sizeof(reply->hdr) - avail);
+	}
+
+	memcpy(&reply->hdr, &spi_t->window[offset], sizeof(reply->hdr));
+
+	PIXY2_STATS_MARK(t, PIXY2_STATS_SYNC);
+
+	/* reject malformed replies before clocking in the rest of their payload */
+	ret = pixy2_protocol_check_header(&reply->hdr, t->reply_type,
+					  reply->min_len, t->reply_len);
+	if (ret) {
+		LOG_ERR("invalid reply header (type 0x%x, size %d): %d",
+			reply->hdr.type, reply->hdr.len, ret);
+		return ret;
+	}
+
+	/* the bytes following the header are the beginning of the payload */
+	avail = MIN(avail - sizeof(reply->hdr), reply->hdr.len);
+
+	memcpy(reply->payload, &spi_t->window[offset + sizeof(reply->hdr)],
+	       avail);
+
+	if (reply->hdr.len == avail) {
+		return 0;
+	}
+
+	/* finally, get the rest of the payload */
+	t->stage = PIXY2_TRANSPORT_STAGE_PAYLOAD;
+
+	ret = pixy2_transport_rtio_read(t, reply->payload + avail,
+					reply->hdr.len - avail, 0);
+	if (ret) {
+		LOG_ERR("failed to submit payload read: %d", ret);
+		return ret;
+	}
+
+	return -EINPROGRESS;
+}
+
+static int pixy2_transport_spi_complete(struct pixy2_transport *t, bool wait)
+{
+	int ret;
+	struct pixy2_message *reply;
+	struct pixy2_spi_transport *spi_t;
+
+	spi_t = CONTAINER_OF(t, struct pixy2_spi_transport, t);
+	reply = t->pending;
+
+	do {
+		ret = pixy2_transport_rtio_reap(t, wait);
+		if (ret == -EAGAIN) {
+			return ret;
+		}
+
+		if (ret) {
+			LOG_ERR("failed to transceive: %d", ret);
+			break;
+		}
+
+		if (t->stage == PIXY2_TRANSPORT_STAGE_PAYLOAD) {
+			break;
+		}
+
+		ret = pixy2_transport_spi_header(spi_t, reply);
+	} while (ret == -EINPROGRESS);
+
+	/* short replies were read along with their header, in no time */
+	if (!ret) {
+		PIXY2_STATS_MARK(t, PIXY2_STATS_RECV);
+	}
+
+	t->pending = NULL;
+
+	return ret;
+}
+
+static int pixy2_transport_spi_transceive(struct pixy2_transport *t,
+					  struct pixy2_message *req,
+					  struct pixy2_message *reply)
+{
+	int ret;
+
+	/* pixy2_transport_transceive() made sure nothing is in flight */
+	ret = pixy2_transport_spi_submit(t, req, reply);
+	if (ret) {
+		LOG_ERR("failed to submit request: %d", ret);
+		return ret;
+	}
+
+	return pixy2_transport_spi_complete(t, true);
+}
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
+
+/* number of bytes clocked in at once while draining the camera */
+#define PIXY2_SPI_DRAIN_WINDOW_LEN	24
+/* maximum number of windows clocked in before the camera goes quiet */
+#define PIXY2_SPI_DRAIN_WINDOWS		16
+
+/* true if the camera had nothing to send while the buffer was clocked in */
+static bool pixy2_transport_spi_idle(const uint8_t *buf, size_t len)
+{
+	while (len--) {
+		if (*buf++ != PIXY2_SPI_IDLE_BYTE) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static int pixy2_transport_spi_recover(struct pixy2_transport *t)
+{
+	int ret, i;
+	uint8_t buf[PIXY2_FLUSH_LEN];
+	struct pixy2_spi_transport *spi_t;
+	struct spi_buf buffer = {
+		.buf = buf,
+		.len = sizeof(buf),
+	};
+
+	spi_t = CONTAINER_OF(t, struct pixy2_spi_transport, t);
+
+	if (!spi_t->spec) {
+		pixy2_spi_config_default(spi_t);
+	}
+
+	/*
+	 * the camera might be waiting for the rest of a request or be in the
+	 * middle of sending a reply. Clocking out enough zeros completes any
+	 * partial request and gets rid of any partial reply.
+	 */
+	memset(buf, 0, sizeof(buf));
+
+	ret = pixy2_spi_send(spi_t, &buffer, 1);
+	if (ret) {
+		LOG_ERR("failed to flush camera: %d", ret);
+		return ret;
+	}
+
+	/* give the camera some time to answer the completed request */
+	k_sleep(K_USEC(PIXY2_RECOVERY_DELAY_US));
+
+	/*
+	 * drain the answer, if any, until a whole window is made of idle
+	 * bytes. A window holding no reply header may still be in the middle
+	 * of a long reply payload.
+	 */
+	buffer.len = PIXY2_SPI_DRAIN_WINDOW_LEN;
+
+	for (i = 0; i < PIXY2_SPI_DRAIN_WINDOWS; i++) {
+		ret = pixy2_spi_recv(spi_t, &buffer, 1);
+		if (ret) {
+			LOG_ERR("failed to drain camera: %d", ret);
+			return ret;
+		}
+
+		if (pixy2_transport_spi_idle(buf, buffer.len)) {
+			return 0;
+		}
+	}
+
+	LOG_ERR("camera did not go quiet");
+
+	return -EIO;
+}
+
+static int pixy2_transport_spi_set_rate(struct pixy2_transport *t,
+					uint32_t rate)
+{
+	struct pixy2_spi_transport *spi_t;
+
+	spi_t = CONTAINER_OF(t, struct pixy2_spi_transport, t);
+
+	if (!rate) {
+		return -EINVAL;
+	}
+
+	pixy2_transport_spi_config_init(spi_t, rate);
+
 	return 0;
 }
 
 const struct pixy2_transport_api pixy2_transport_spi_api = {
 	.transceive = pixy2_transport_spi_transceive,
+	.recover = pixy2_transport_spi_recover,
+	.set_rate = pixy2_transport_spi_set_rate,
+	.rates = pixy2_transport_spi_rates,
+	.num_rates = ARRAY_SIZE(pixy2_transport_spi_rates),
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+	.submit = pixy2_transport_spi_submit,
+	.complete = pixy2_transport_spi_complete,
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
 };
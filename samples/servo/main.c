@@ -19,13 +19,28 @@ LOG_MODULE_REGISTER(main);
 /* PWM signal period (in NS) */
 #define SERVO_PWM_PERIOD_NS	20000000
 
-/* how much do we increment the angle in a single step? */
-#define SERVO_ANGLE_STEP	10
+/*
+ * offset added to all angles (in millidegrees). Tune this for your car
+ * such that the wheels point straight when the servo is set to 90 degrees.
+ */
+#define SERVO_TRIM_MDEG		0
+
+/* how much do we increment the angle in a single step? (in millidegrees) */
+#define SERVO_ANGLE_STEP	10000
 
 static struct nxp_servo servo = {
 	.pwm_dev = DEVICE_DT_GET(DT_NODELABEL(tpm3)),
 	.channel = SERVO_PWM_CHANNEL,
 	.period = SERVO_PWM_PERIOD_NS,
+	.cal = {
+		/* the MG996R datasheet values, may differ from servo to servo */
+		.left_ns = SERVO_MSEC_LEFT,
+		.right_ns = SERVO_MSEC_RIGHT,
+		.trim_mdeg = SERVO_TRIM_MDEG,
+		/* narrow these down if the wheels hit the chassis */
+		.min_mdeg = 0,
+		.max_mdeg = SERVO_MAX_MDEG,
+	},
 };
 
 int main(void)
@@ -33,18 +48,25 @@ int main(void)
 	uint32_t angle;
 	int ret;
 
+	ret = servo_init(&servo);
+	if (ret) {
+		LOG_ERR("failed to initialize servo: %d", ret);
+		return ret;
+	}
+
 	angle = 0;
 
 	while (true) {
-		LOG_INF("setting servo angle to %u degrees", angle);
+		LOG_INF("setting servo angle to %u.%03u degrees",
+			angle / 1000, angle % 1000);
 
-		ret = servo_set_angle(&servo, angle);
+		ret = servo_set_angle_mdeg(&servo, angle);
 		if (ret) {
-			LOG_ERR("failed to set angle to %u: %d", angle, ret);
+			LOG_ERR("failed to set angle to %u mdeg: %d", angle, ret);
 			return ret;
 		}
 
-		if (angle == SERVO_MAX_ANGLE) {
+		if (angle == SERVO_MAX_MDEG) {
 			angle = 0;
 		} else {
 			angle += SERVO_ANGLE_STEP;
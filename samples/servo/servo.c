@@ -10,47 +10,154 @@
 
 LOG_MODULE_REGISTER(servo);
 
-int servo_set_angle(struct nxp_servo *servo, uint32_t angle)
+/* the centre position, before trimming */
+#define SERVO_CENTRE_MDEG	(SERVO_MAX_MDEG / 2)
+
+static uint32_t servo_mdeg_to_cycles(struct nxp_servo *servo, uint32_t mdeg)
+{
+	return servo->left_cycles + ((mdeg * servo->mdeg_cycles) >> 32);
+}
+
+static int servo_set_cycles(struct nxp_servo *servo, uint32_t pulse)
 {
-	uint32_t pulse_duration;
-	float nsec_per_degree;
 	int ret;
 
+	/*
+	 * configure the PWM signal with the following properties:
+	 *
+	 * - PERIOD = servo->period_cycles
+	 * - DUTY = pulse
+	 * - POLARITY = NORMAL
+	 * - CHANNEL = servo->channel
+	 */
+	ret = pwm_set_cycles(servo->pwm_dev, servo->channel,
+			     servo->period_cycles, pulse, PWM_POLARITY_NORMAL);
+	if (ret < 0) {
+		LOG_ERR("failed to configure PWM: %d", ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+int servo_init(struct nxp_servo *servo)
+{
+	int ret;
+	int32_t centre;
+	uint64_t cycles_per_sec, period_cycles;
+	uint32_t right_cycles;
+	struct nxp_servo_calibration *cal;
+
 	/* sanity checks */
 	if (!servo || !servo->pwm_dev) {
 		return -EINVAL;
 	}
 
-	/* angle needs to be in [0, 180] interval */
-	if (angle > SERVO_MAX_ANGLE) {
-		LOG_ERR("invalid angle: %u", angle);
+	cal = &servo->cal;
+	centre = SERVO_CENTRE_MDEG + cal->trim_mdeg;
+
+	if (!cal->left_ns || cal->left_ns >= cal->right_ns ||
+	    cal->right_ns > servo->period) {
+		LOG_ERR("invalid pulse durations: %u ns to %u ns",
+			cal->left_ns, cal->right_ns);
+		return -EINVAL;
+	}
+
+	if (cal->min_mdeg > cal->max_mdeg || cal->max_mdeg > SERVO_MAX_MDEG ||
+	    centre < (int32_t)cal->min_mdeg || centre > (int32_t)cal->max_mdeg) {
+		LOG_ERR("invalid limits: %u mdeg to %u mdeg, centre at %d mdeg",
+			cal->min_mdeg, cal->max_mdeg, centre);
 		return -EINVAL;
 	}
 
+	ret = pwm_get_cycles_per_sec(servo->pwm_dev, servo->channel,
+				     &cycles_per_sec);
+	if (ret) {
+		LOG_ERR("failed to get PWM clock rate: %d", ret);
+		return ret;
+	}
+
+	period_cycles = (cycles_per_sec * servo->period) / NSEC_PER_SEC;
+	if (!period_cycles || period_cycles > UINT32_MAX) {
+		LOG_ERR("invalid period: %u ns at %u Hz",
+			servo->period, (uint32_t)cycles_per_sec);
+		return -EINVAL;
+	}
+
+	servo->period_cycles = period_cycles;
+	servo->left_cycles = (cycles_per_sec * cal->left_ns) / NSEC_PER_SEC;
+	right_cycles = (cycles_per_sec * cal->right_ns) / NSEC_PER_SEC;
+
 	/*
 	 * based on the most right and left position of the servo,
-	 * find out how many nanoseconds of the pulse correspond to
-	 * 1 degree.
+	 * find out how many cycles of the pulse correspond to 1
+	 * millidegree, as a 32.32 fixed-point number.
 	 */
-	nsec_per_degree = (SERVO_MSEC_RIGHT - SERVO_MSEC_LEFT) / SERVO_MAX_ANGLE;
+	servo->mdeg_cycles = ((uint64_t)(right_cycles - servo->left_cycles) << 32) /
+		SERVO_MAX_MDEG;
 
-	/* the most left position corresponds to 0 degrees */
-	pulse_duration = SERVO_MSEC_LEFT + (float)angle * nsec_per_degree;
+	servo->min_cycles = servo_mdeg_to_cycles(servo, cal->min_mdeg);
+	servo->centre_cycles = servo_mdeg_to_cycles(servo, centre);
+	servo->max_cycles = servo_mdeg_to_cycles(servo, cal->max_mdeg);
 
-	/*
-	 * configure the PWM signal with the following properties:
-	 *
-	 * - PERIOD = SERVO_PWM_PERIOD_NS
-	 * - DUTY = pulse_duration
-	 * - POLARITY = NORMAL
-	 * - CHANNEL = SERVO_PWM_CHANNEL
-	 */
-	ret = pwm_set(servo->pwm_dev, servo->channel, servo->period,
-		      pulse_duration, PWM_POLARITY_NORMAL);
-	if (ret < 0) {
-		LOG_ERR("failed to configure PWM: %d", ret);
-		return ret;
-	}
+	LOG_DBG("pulse: %u to %u cycles, centre at %u cycles, period: %u cycles",
+		servo->min_cycles, servo->max_cycles, servo->centre_cycles,
+		servo->period_cycles);
 
 	return 0;
 }
+
+int servo_set_angle_mdeg(struct nxp_servo *servo, uint32_t mdeg)
+{
+	int32_t trimmed;
+
+	/* sanity checks - servo_init() must have been called first */
+	if (!servo || !servo->pwm_dev || !servo->period_cycles) {
+		return -EINVAL;
+	}
+
+	/* angle needs to be in [0, 180000] interval */
+	if (mdeg > SERVO_MAX_MDEG) {
+		LOG_ERR("invalid angle: %u mdeg", mdeg);
+		return -EINVAL;
+	}
+
+	trimmed = CLAMP((int32_t)mdeg + servo->cal.trim_mdeg,
+			(int32_t)servo->cal.min_mdeg, (int32_t)servo->cal.max_mdeg);
+
+	return servo_set_cycles(servo, servo_mdeg_to_cycles(servo, trimmed));
+}
+
+int servo_set_position(struct nxp_servo *servo, int16_t position)
+{
+	uint32_t pulse;
+
+	/* sanity checks - servo_init() must have been called first */
+	if (!servo || !servo->pwm_dev || !servo->period_cycles) {
+		return -EINVAL;
+	}
+
+	/* the limits may not be symmetrical around the centre */
+	if (position < 0) {
+		pulse = servo->centre_cycles -
+			(((uint64_t)(servo->centre_cycles - servo->min_cycles) *
+			  -position) >> 15);
+	} else {
+		pulse = servo->centre_cycles +
+			(((uint64_t)(servo->max_cycles - servo->centre_cycles) *
+			  position) >> 15);
+	}
+
+	return servo_set_cycles(servo, pulse);
+}
+
+int servo_set_angle(struct nxp_servo *servo, uint32_t angle)
+{
+	/* angle needs to be in [0, 180] interval */
+	if (angle > SERVO_MAX_ANGLE) {
+		LOG_ERR("invalid angle: %u", angle);
+		return -EINVAL;
+	}
+
+	return servo_set_angle_mdeg(servo, angle * 1000);
+}
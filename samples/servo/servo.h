@@ -20,14 +20,36 @@
 #define MSEC_TO_NSEC(x) ((x) * NSEC_PER_MSEC)
 
 /** 1ms PWM duty cycle means the servo is in the most left position */
-#define SERVO_MSEC_LEFT         MSEC_TO_NSEC(1.0f)
+#define SERVO_MSEC_LEFT         MSEC_TO_NSEC(1)
 
 /** 2ms PWM duty cycle means the servo is in the most right position */
-#define SERVO_MSEC_RIGHT        MSEC_TO_NSEC(2.0f)
+#define SERVO_MSEC_RIGHT        MSEC_TO_NSEC(2)
 
 /** maximum angle supported by the servo */
 #define SERVO_MAX_ANGLE         180
 
+/** maximum angle supported by the servo (in millidegrees) */
+#define SERVO_MAX_MDEG          (SERVO_MAX_ANGLE * 1000)
+
+/**
+ * @struct nxp_servo_calibration
+ * @brief Per-car calibration of the MG996R servo motor
+ *
+ * All angles are in millidegrees, 0 being the most left position.
+ */
+struct nxp_servo_calibration {
+	/** pulse duration in the most left position (in nanoseconds) */
+	uint32_t left_ns;
+	/** pulse duration in the most right position (in nanoseconds) */
+	uint32_t right_ns;
+	/** offset added to all angles, such that the wheels point straight at 90 degrees */
+	int32_t trim_mdeg;
+	/** lowest angle the servo may be set to, trim included */
+	uint32_t min_mdeg;
+	/** highest angle the servo may be set to, trim included */
+	uint32_t max_mdeg;
+};
+
 /**
  * @struct nxp_servo
  * @brief Represents the MG996R servo motor
@@ -39,15 +61,81 @@ struct nxp_servo {
 	uint32_t period;
 	/** PWM channel to use */
 	uint32_t channel;
+	/** calibration of the servo */
+	struct nxp_servo_calibration cal;
+	/** PWM period (in cycles), set by servo_init() */
+	uint32_t period_cycles;
+	/** pulse duration at 0 degrees (in cycles), set by servo_init() */
+	uint32_t left_cycles;
+	/** pulse duration per millidegree (in 2^-32 cycles), set by servo_init() */
+	uint64_t mdeg_cycles;
+	/** pulse duration at the lowest angle (in cycles), set by servo_init() */
+	uint32_t min_cycles;
+	/** pulse duration at the trimmed centre (in cycles), set by servo_init() */
+	uint32_t centre_cycles;
+	/** pulse duration at the highest angle (in cycles), set by servo_init() */
+	uint32_t max_cycles;
 };
 
+/**
+ * @brief Initialize the servo motor
+ *
+ * Convert the PWM period and the calibration into PWM clock cycles, such
+ * that setting the angle later on only takes integer multiplications and
+ * shifts. Must be called before any other servo function, which otherwise
+ * return -EINVAL.
+ *
+ * @param servo pointer to the structure representing the MG996R servo motor
+ *
+ * @retval 0 on success
+ * @retval -EINVAL if the calibration is invalid
+ * @retval negative errno code if failure
+ */
+int servo_init(struct nxp_servo *servo);
+
+/**
+ * @brief Set the angle of the servo motor with a sub-degree resolution
+ *
+ * The calibration trim is added to the angle, which is then clamped to
+ * the calibration limits.
+ *
+ * @param servo pointer to the structure representing the MG996R servo motor
+ * @param mdeg angle to set (between 0 and #SERVO_MAX_MDEG millidegrees)
+ *
+ * @retval 0 on success
+ * @retval -EINVAL if the servo was not initialized using servo_init()
+ * @retval negative errno code if failure
+ */
+int servo_set_angle_mdeg(struct nxp_servo *servo, uint32_t mdeg);
+
+/**
+ * @brief Set the position of the servo motor relative to its limits
+ *
+ * Meant for steering: the position is a Q15 fixed-point number, where:
+ *
+ * - -32768 (i.e. -1.0) means the lowest angle (calibration limit)
+ * - 0 means the trimmed centre (i.e. the wheels point straight)
+ * - 32767 (i.e. ~1.0) means the highest angle (calibration limit)
+ *
+ * @param servo pointer to the structure representing the MG996R servo motor
+ * @param position position to set
+ *
+ * @retval 0 on success
+ * @retval -EINVAL if the servo was not initialized using servo_init()
+ * @retval negative errno code if failure
+ */
+int servo_set_position(struct nxp_servo *servo, int16_t position);
+
 /**
  * @brief Set the angle of the servo motor
  *
+ * Same as servo_set_angle_mdeg(), with a whole degree resolution.
+ *
  * @param servo pointer to the structure representing the MG996R servo motor
  * @param angle angle to set (between 0 and 180 degrees)
  *
  * @retval 0 on success
+ * @retval -EINVAL if the servo was not initialized using servo_init()
  * @retval negative errno code if failure
  */
 int servo_set_angle(struct nxp_servo *servo, uint32_t angle);
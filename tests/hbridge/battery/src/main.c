@@ -0,0 +1,180 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Feed battery voltages to the emulated ADC, draining it from full to
+ * empty, and check the duty cycles applied to the motors are scaled such
+ * that their average voltage stays the same.
+ */
+
+#include <zephyr/drivers/adc/adc_emul.h>
+#include <zephyr/ztest.h>
+
+#include "hbridge.h"
+
+/* same wiring as the sample */
+#define HBRIDGE_IN1_GPIO		2
+#define HBRIDGE_IN2_GPIO		3
+#define HBRIDGE_IN3_GPIO		17
+#define HBRIDGE_IN4_GPIO		27
+#define HBRIDGE_ENA_PWM_CHANNEL		1
+#define HBRIDGE_ENB_PWM_CHANNEL		2
+#define HBRIDGE_BATTERY_RTOP		47000
+#define HBRIDGE_BATTERY_RBOTTOM		10000
+
+/* PWM period in nanoseconds */
+#define HBRIDGE_PERIOD_NS		(NSEC_PER_SEC / CONFIG_NXPCUP_HBRIDGE_PWM_FREQUENCY)
+
+/* battery voltage when fully charged and empty (in mV) */
+#define BATTERY_FULL_MV			8400
+#define BATTERY_EMPTY_MV		6600
+
+/* battery voltage drop per drain step (in mV) */
+#define BATTERY_DRAIN_MV		100
+
+/* time given to the battery voltage filter to settle (~12 time constants) */
+#define SETTLE_MS			((12 * CONFIG_NXPCUP_HBRIDGE_BATTERY_PERIOD_MS) << \
+					 CONFIG_NXPCUP_HBRIDGE_BATTERY_FILTER_SHIFT)
+
+/*
+ * maximum difference between the filtered and the fed voltages (in mV).
+ * The ADC input is truncated to the mV twice (fed voltage and sample), and
+ * then multiplied by the divider ratio.
+ */
+#define BATTERY_TOLERANCE		20
+
+/* maximum difference between the duty cycles and the expected ones (in permille) */
+#define DUTY_CYCLE_TOLERANCE		2
+
+static struct nxp_hbridge hbridge = {
+	.gpio_dev = DEVICE_DT_GET(DT_NODELABEL(gpio2)),
+	.pwm_dev = DEVICE_DT_GET(DT_NODELABEL(tpm4)),
+	.period = HBRIDGE_PERIOD_NS,
+	.lgpios = { HBRIDGE_IN1_GPIO, HBRIDGE_IN2_GPIO },
+	.rgpios = { HBRIDGE_IN3_GPIO, HBRIDGE_IN4_GPIO },
+	.lchan = HBRIDGE_ENA_PWM_CHANNEL,
+	.rchan = HBRIDGE_ENB_PWM_CHANNEL,
+	.lflags = NXP_HBRIDGE_MOTOR_INVERT,
+	.battery = ADC_DT_SPEC_GET(DT_PATH(zephyr_user)),
+	.battery_rtop = HBRIDGE_BATTERY_RTOP,
+	.battery_rbottom = HBRIDGE_BATTERY_RBOTTOM,
+};
+
+/* feed the battery voltage to the ADC, through the voltage divider */
+static void set_battery(int32_t mv)
+{
+	zassert_ok(adc_emul_const_value_set(hbridge.battery.dev,
+					    hbridge.battery.channel_id,
+					    (mv * HBRIDGE_BATTERY_RBOTTOM) /
+					    (HBRIDGE_BATTERY_RTOP + HBRIDGE_BATTERY_RBOTTOM)));
+}
+
+/* duty cycle giving the same average voltage as speed with a nominal battery */
+static int32_t expected_duty_cycle(int32_t speed, int32_t mv)
+{
+	int32_t duty_cycle;
+
+	duty_cycle = (speed * CONFIG_NXPCUP_HBRIDGE_BATTERY_NOMINAL_MV) / mv;
+
+	return CLAMP(duty_cycle, -NXP_HBRIDGE_MAX_SPEED, NXP_HBRIDGE_MAX_SPEED);
+}
+
+/* check the battery voltage and the duty cycles applied for it */
+static void check(int32_t lspeed, int32_t rspeed, int32_t mv)
+{
+	int32_t battery, lduty_cycle, rduty_cycle;
+
+	zassert_ok(nxp_hbridge_get_battery(&hbridge, &battery));
+	zassert_within(battery, mv, BATTERY_TOLERANCE,
+		       "battery at %d mV instead of %d mV", battery, mv);
+
+	zassert_ok(nxp_hbridge_get_duty_cycle(&hbridge, &lduty_cycle, &rduty_cycle));
+	zassert_within(lduty_cycle, expected_duty_cycle(lspeed, mv),
+		       DUTY_CYCLE_TOLERANCE, "left duty cycle %d instead of %d at %d mV",
+		       lduty_cycle, expected_duty_cycle(lspeed, mv), mv);
+	zassert_within(rduty_cycle, expected_duty_cycle(rspeed, mv),
+		       DUTY_CYCLE_TOLERANCE, "right duty cycle %d instead of %d at %d mV",
+		       rduty_cycle, expected_duty_cycle(rspeed, mv), mv);
+}
+
+ZTEST(hbridge_battery, test_scaling)
+{
+	size_t i;
+	static const int32_t voltages[] = {
+		BATTERY_FULL_MV,
+		CONFIG_NXPCUP_HBRIDGE_BATTERY_NOMINAL_MV,
+		BATTERY_EMPTY_MV,
+	};
+
+	zassert_ok(nxp_hbridge_set_motors(&hbridge, 500, -300));
+
+	for (i = 0; i < ARRAY_SIZE(voltages); i++) {
+		set_battery(voltages[i]);
+		k_sleep(K_MSEC(SETTLE_MS));
+
+		check(500, -300, voltages[i]);
+	}
+}
+
+ZTEST(hbridge_battery, test_drain)
+{
+	int32_t mv, lprevious, rprevious, lduty_cycle, rduty_cycle;
+
+	set_battery(BATTERY_FULL_MV);
+	zassert_ok(nxp_hbridge_set_motors(&hbridge, 600, 600));
+	k_sleep(K_MSEC(SETTLE_MS));
+
+	zassert_ok(nxp_hbridge_get_duty_cycle(&hbridge, &lprevious, &rprevious));
+
+	/* the duty cycles follow the battery down, lagging behind the filter */
+	for (mv = BATTERY_FULL_MV - BATTERY_DRAIN_MV; mv >= BATTERY_EMPTY_MV;
+	     mv -= BATTERY_DRAIN_MV) {
+		set_battery(mv);
+		k_sleep(K_MSEC(CONFIG_NXPCUP_HBRIDGE_BATTERY_PERIOD_MS * 10));
+
+		zassert_ok(nxp_hbridge_get_duty_cycle(&hbridge, &lduty_cycle,
+						      &rduty_cycle));
+		zassert_true(lduty_cycle > lprevious, "left duty cycle %d after %d at %d mV",
+			     lduty_cycle, lprevious, mv);
+		zassert_true(rduty_cycle > rprevious, "right duty cycle %d after %d at %d mV",
+			     rduty_cycle, rprevious, mv);
+
+		lprevious = lduty_cycle;
+		rprevious = rduty_cycle;
+	}
+
+	k_sleep(K_MSEC(SETTLE_MS));
+
+	check(600, 600, BATTERY_EMPTY_MV);
+}
+
+ZTEST(hbridge_battery, test_full_speed)
+{
+	/* a low battery can't make up for more than the full speed */
+	set_battery(BATTERY_EMPTY_MV);
+	zassert_ok(nxp_hbridge_set_motors(&hbridge, NXP_HBRIDGE_MAX_SPEED,
+					  -NXP_HBRIDGE_MAX_SPEED));
+	k_sleep(K_MSEC(SETTLE_MS));
+
+	check(NXP_HBRIDGE_MAX_SPEED, -NXP_HBRIDGE_MAX_SPEED, BATTERY_EMPTY_MV);
+}
+
+static void *hbridge_battery_setup(void)
+{
+	/* the battery has to be there before the H-BRIDGE samples it */
+	set_battery(CONFIG_NXPCUP_HBRIDGE_BATTERY_NOMINAL_MV);
+	zassert_ok(nxp_hbridge_init(&hbridge));
+
+	return NULL;
+}
+
+static void hbridge_battery_after(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	zassert_ok(nxp_hbridge_set_motors(&hbridge, 0, 0));
+}
+
+ZTEST_SUITE(hbridge_battery, NULL, hbridge_battery_setup, NULL,
+	    hbridge_battery_after, NULL);
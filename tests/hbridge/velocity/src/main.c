@@ -0,0 +1,146 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Hold a few wheel velocities using the velocity loop, the encoder edges
+ * being produced by the model of the motors and wheels, and check the
+ * measured velocities settle close to their set points.
+ */
+
+#include <zephyr/ztest.h>
+
+#include "hbridge.h"
+#include "hbridge_plant.h"
+
+/* same wiring as the sample */
+#define HBRIDGE_IN1_GPIO		2
+#define HBRIDGE_IN2_GPIO		3
+#define HBRIDGE_IN3_GPIO		17
+#define HBRIDGE_IN4_GPIO		27
+#define HBRIDGE_ENA_PWM_CHANNEL		1
+#define HBRIDGE_ENB_PWM_CHANNEL		2
+#define HBRIDGE_LENC_GPIO		5
+#define HBRIDGE_RENC_GPIO		6
+#define HBRIDGE_ENCODER_TICKS_PER_M	2000
+#define HBRIDGE_BATTERY_RTOP		47000
+#define HBRIDGE_BATTERY_RBOTTOM		10000
+
+/* PWM period in nanoseconds */
+#define HBRIDGE_PERIOD_NS		(NSEC_PER_SEC / CONFIG_NXPCUP_HBRIDGE_PWM_FREQUENCY)
+
+/* time given to the loop to reach a new set point */
+#define SETTLE_MS			2000
+
+/*
+ * a single edge per loop period is worth 1000 / (ticks_per_m * period)
+ * m/s, which is too coarse for a single measurement to be compared, so
+ * the velocity is averaged over this many periods.
+ */
+#define NUM_SAMPLES			50
+
+/* maximum difference between the average velocity and the set point (in mm/s) */
+#define VELOCITY_TOLERANCE		25
+
+/* battery voltage when almost empty (in mV) */
+#define BATTERY_LOW_MV			6600
+
+static struct nxp_hbridge hbridge = {
+	.gpio_dev = DEVICE_DT_GET(DT_NODELABEL(gpio2)),
+	.pwm_dev = DEVICE_DT_GET(DT_NODELABEL(tpm4)),
+	.period = HBRIDGE_PERIOD_NS,
+	.lgpios = { HBRIDGE_IN1_GPIO, HBRIDGE_IN2_GPIO },
+	.rgpios = { HBRIDGE_IN3_GPIO, HBRIDGE_IN4_GPIO },
+	.lchan = HBRIDGE_ENA_PWM_CHANNEL,
+	.rchan = HBRIDGE_ENB_PWM_CHANNEL,
+	.lflags = NXP_HBRIDGE_MOTOR_INVERT,
+	.enc_dev = DEVICE_DT_GET(DT_NODELABEL(gpio2)),
+	.enc_gpios = { HBRIDGE_LENC_GPIO, HBRIDGE_RENC_GPIO },
+	.ticks_per_m = HBRIDGE_ENCODER_TICKS_PER_M,
+#ifdef CONFIG_NXPCUP_HBRIDGE_BATTERY
+	.battery = ADC_DT_SPEC_GET(DT_PATH(zephyr_user)),
+	.battery_rtop = HBRIDGE_BATTERY_RTOP,
+	.battery_rbottom = HBRIDGE_BATTERY_RBOTTOM,
+#endif /* CONFIG_NXPCUP_HBRIDGE_BATTERY */
+};
+
+/* set the velocities, let them settle and check their average */
+static void hold(int32_t lsetpoint, int32_t rsetpoint)
+{
+	int i;
+	int32_t lvelocity, rvelocity, lsum, rsum;
+
+	zassert_ok(nxp_hbridge_set_velocity(&hbridge, lsetpoint, rsetpoint));
+
+	k_sleep(K_MSEC(SETTLE_MS));
+
+	lsum = 0;
+	rsum = 0;
+
+	for (i = 0; i < NUM_SAMPLES; i++) {
+		k_sleep(K_MSEC(CONFIG_NXPCUP_HBRIDGE_PID_PERIOD_MS));
+
+		zassert_ok(nxp_hbridge_get_velocity(&hbridge, &lvelocity, &rvelocity));
+
+		lsum += lvelocity;
+		rsum += rvelocity;
+	}
+
+	zassert_within(lsum / NUM_SAMPLES, lsetpoint, VELOCITY_TOLERANCE,
+		       "left wheel at %d mm/s instead of %d mm/s",
+		       lsum / NUM_SAMPLES, lsetpoint);
+	zassert_within(rsum / NUM_SAMPLES, rsetpoint, VELOCITY_TOLERANCE,
+		       "right wheel at %d mm/s instead of %d mm/s",
+		       rsum / NUM_SAMPLES, rsetpoint);
+}
+
+ZTEST(hbridge_velocity, test_setpoints)
+{
+	size_t i;
+	/* same velocities as the sample, including a change of direction */
+	static const int32_t velocities[] = { 500, 1000, 300, -500, 0 };
+
+	for (i = 0; i < ARRAY_SIZE(velocities); i++) {
+		hold(velocities[i], velocities[i]);
+	}
+}
+
+ZTEST(hbridge_velocity, test_turn)
+{
+	/* each wheel has a loop of its own */
+	hold(800, 200);
+	hold(-300, 600);
+	hold(0, 0);
+}
+
+ZTEST(hbridge_velocity, test_low_battery)
+{
+	hold(1000, 1000);
+
+	/* the loop makes up for the lower motor voltage */
+	zassert_ok(hbridge_plant_set_battery(&hbridge, BATTERY_LOW_MV));
+
+	hold(1000, 1000);
+	hold(0, 0);
+}
+
+static void *hbridge_velocity_setup(void)
+{
+	/* the battery has to be there before the H-BRIDGE samples it */
+	zassert_ok(hbridge_plant_set_battery(&hbridge, HBRIDGE_PLANT_NOMINAL_MV));
+	zassert_ok(nxp_hbridge_init(&hbridge));
+	zassert_ok(hbridge_plant_start(&hbridge));
+
+	return NULL;
+}
+
+static void hbridge_velocity_after(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	zassert_ok(nxp_hbridge_set_velocity(&hbridge, 0, 0));
+	zassert_ok(hbridge_plant_set_battery(&hbridge, HBRIDGE_PLANT_NOMINAL_MV));
+}
+
+ZTEST_SUITE(hbridge_velocity, NULL, hbridge_velocity_setup, NULL,
+	    hbridge_velocity_after, NULL);
@@ -0,0 +1,221 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Check the track centerline estimation against known vector sets.
+ */
+
+#include <zephyr/ztest.h>
+
+#include "pixy2_centerline.h"
+
+/* the track is 60 grid units wide at the near row and 20 at the far row */
+static const struct pixy2_centerline_config cfg = {
+	.near_row = 51,
+	.far_row = 11,
+	.near_half_width = PIXY2_CENTERLINE_FIXED(30),
+	.far_half_width = PIXY2_CENTERLINE_FIXED(10),
+};
+
+/* heading tolerance, matches the arctangent approximation error */
+#define HEADING_TOLERANCE_MDEG	250
+
+#define VECTOR(_x0, _y0, _x1, _y1)					\
+	{ .x0 = _x0, .y0 = _y0, .x1 = _x1, .y1 = _y1 }
+
+static void features_init(struct pixy2_features *f,
+			  const struct pixy2_vector *vectors, uint8_t num)
+{
+	memset(f, 0, sizeof(*f));
+
+	f->vectors = vectors;
+	f->num_vectors = num;
+}
+
+ZTEST(pixy2_centerline, test_straight)
+{
+	struct pixy2_features f;
+	struct pixy2_centerline c;
+	static const struct pixy2_vector v[] = {
+		/* left and right boundaries, converging towards the far row */
+		VECTOR(9, 51, 29, 11),
+		VECTOR(69, 51, 49, 11),
+	};
+
+	features_init(&f, v, ARRAY_SIZE(v));
+
+	zassert_ok(pixy2_centerline_estimate(&cfg, &f, &c));
+	zassert_equal(c.offset, 0);
+	zassert_equal(c.heading, 0);
+	zassert_equal(c.curvature, 0);
+	zassert_equal(c.sides, PIXY2_CENTERLINE_LEFT | PIXY2_CENTERLINE_RIGHT);
+}
+
+ZTEST(pixy2_centerline, test_offset)
+{
+	struct pixy2_features f;
+	struct pixy2_centerline c;
+	static const struct pixy2_vector v[] = {
+		/* same track, seen from a car standing 5 units to the left */
+		VECTOR(14, 51, 34, 11),
+		VECTOR(74, 51, 54, 11),
+	};
+	static const struct pixy2_vector w[] = {
+		/* and from a car standing 5 units to the right */
+		VECTOR(4, 51, 24, 11),
+		VECTOR(64, 51, 44, 11),
+	};
+
+	features_init(&f, v, ARRAY_SIZE(v));
+
+	zassert_ok(pixy2_centerline_estimate(&cfg, &f, &c));
+	zassert_equal(c.offset, PIXY2_CENTERLINE_FIXED(5));
+	zassert_equal(c.heading, 0);
+	zassert_equal(c.curvature, 0);
+
+	features_init(&f, w, ARRAY_SIZE(w));
+
+	zassert_ok(pixy2_centerline_estimate(&cfg, &f, &c));
+	zassert_equal(c.offset, PIXY2_CENTERLINE_FIXED(-5));
+	zassert_equal(c.heading, 0);
+	zassert_equal(c.curvature, 0);
+}
+
+ZTEST(pixy2_centerline, test_heading)
+{
+	struct pixy2_features f;
+	struct pixy2_centerline c;
+	static const struct pixy2_vector v[] = {
+		/* centerline going 10 units right over 40 rows: 14.036 degrees */
+		VECTOR(9, 51, 39, 11),
+		VECTOR(69, 51, 59, 11),
+	};
+	static const struct pixy2_vector w[] = {
+		/* mirrored: 10 units left over 40 rows */
+		VECTOR(9, 51, 19, 11),
+		VECTOR(69, 51, 39, 11),
+	};
+
+	features_init(&f, v, ARRAY_SIZE(v));
+
+	zassert_ok(pixy2_centerline_estimate(&cfg, &f, &c));
+	zassert_equal(c.offset, 0);
+	zassert_within(c.heading, 14036, HEADING_TOLERANCE_MDEG);
+	zassert_equal(c.curvature, 0);
+
+	features_init(&f, w, ARRAY_SIZE(w));
+
+	zassert_ok(pixy2_centerline_estimate(&cfg, &f, &c));
+	zassert_equal(c.offset, 0);
+	zassert_within(c.heading, -14036, HEADING_TOLERANCE_MDEG);
+	zassert_equal(c.curvature, 0);
+}
+
+/*
+ * the centerline goes through (39, 51), (41, 31) and (47, 11). The circle
+ * going through them has a curvature of 0.009345 / grid unit, i.e. 612 in
+ * Q16.
+ */
+ZTEST(pixy2_centerline, test_curvature)
+{
+	struct pixy2_features f;
+	struct pixy2_centerline c;
+	static const struct pixy2_vector v[] = {
+		/* each boundary is made of two vectors meeting at row 31 */
+		VECTOR(9, 51, 21, 31),
+		VECTOR(21, 31, 37, 11),
+		VECTOR(69, 51, 61, 31),
+		VECTOR(61, 31, 57, 11),
+	};
+	static const struct pixy2_vector w[] = {
+		/* mirrored around the camera's axis */
+		VECTOR(69, 51, 57, 31),
+		VECTOR(57, 31, 41, 11),
+		VECTOR(9, 51, 17, 31),
+		VECTOR(17, 31, 21, 11),
+	};
+
+	features_init(&f, v, ARRAY_SIZE(v));
+
+	zassert_ok(pixy2_centerline_estimate(&cfg, &f, &c));
+	zassert_equal(c.offset, 0);
+	zassert_within(c.heading, 11310, HEADING_TOLERANCE_MDEG);
+	zassert_within(c.curvature, 612, 2);
+
+	features_init(&f, w, ARRAY_SIZE(w));
+
+	zassert_ok(pixy2_centerline_estimate(&cfg, &f, &c));
+	zassert_equal(c.offset, 0);
+	zassert_within(c.heading, -11310, HEADING_TOLERANCE_MDEG);
+	zassert_within(c.curvature, -612, 2);
+}
+
+ZTEST(pixy2_centerline, test_single_side)
+{
+	struct pixy2_features f;
+	struct pixy2_centerline c;
+	static const struct pixy2_vector left[] = {
+		VECTOR(9, 51, 29, 11),
+	};
+	static const struct pixy2_vector right[] = {
+		/* stops short of the near row, gets extrapolated */
+		VECTOR(64, 41, 49, 11),
+	};
+
+	features_init(&f, left, ARRAY_SIZE(left));
+
+	zassert_ok(pixy2_centerline_estimate(&cfg, &f, &c));
+	zassert_equal(c.offset, 0);
+	zassert_equal(c.heading, 0);
+	zassert_equal(c.curvature, 0);
+	zassert_equal(c.sides, PIXY2_CENTERLINE_LEFT);
+
+	features_init(&f, right, ARRAY_SIZE(right));
+
+	zassert_ok(pixy2_centerline_estimate(&cfg, &f, &c));
+	zassert_equal(c.offset, 0);
+	zassert_equal(c.heading, 0);
+	zassert_equal(c.curvature, 0);
+	zassert_equal(c.sides, PIXY2_CENTERLINE_RIGHT);
+}
+
+ZTEST(pixy2_centerline, test_invalid)
+{
+	struct pixy2_features f;
+	struct pixy2_centerline c;
+	struct pixy2_centerline_config bad = cfg;
+	static const struct pixy2_vector v[] = {
+		/* horizontal and invalid vectors are ignored */
+		VECTOR(9, 30, 69, 30),
+		{ .x0 = 9, .y0 = 51, .x1 = 29, .y1 = 11,
+		  .flags = PIXY2_LINE_FLAG_INVALID },
+	};
+
+	features_init(&f, v, 0);
+	zassert_equal(pixy2_centerline_estimate(&cfg, &f, &c), -ENODATA);
+
+	features_init(&f, v, ARRAY_SIZE(v));
+	zassert_equal(pixy2_centerline_estimate(&cfg, &f, &c), -ENODATA);
+
+	bad.far_row = bad.near_row;
+	zassert_equal(pixy2_centerline_estimate(&bad, &f, &c), -EINVAL);
+
+	bad = cfg;
+	bad.near_row = PIXY2_LINE_GRID_HEIGHT;
+	zassert_equal(pixy2_centerline_estimate(&bad, &f, &c), -EINVAL);
+}
+
+ZTEST(pixy2_centerline, test_atan)
+{
+	zassert_equal(pixy2_atan_mdeg(0, 1), 0);
+	zassert_within(pixy2_atan_mdeg(1, 1), 45000, HEADING_TOLERANCE_MDEG);
+	zassert_within(pixy2_atan_mdeg(-1, 1), -45000, HEADING_TOLERANCE_MDEG);
+	zassert_within(pixy2_atan_mdeg(1, 2), 26565, HEADING_TOLERANCE_MDEG);
+	zassert_within(pixy2_atan_mdeg(-1, 2), -26565, HEADING_TOLERANCE_MDEG);
+	zassert_within(pixy2_atan_mdeg(2, 1), 63435, HEADING_TOLERANCE_MDEG);
+	zassert_within(pixy2_atan_mdeg(-2, 1), -63435, HEADING_TOLERANCE_MDEG);
+	zassert_within(pixy2_atan_mdeg(1000, 1), 89943, HEADING_TOLERANCE_MDEG);
+}
+
+ZTEST_SUITE(pixy2_centerline, NULL, NULL, NULL, NULL, NULL);
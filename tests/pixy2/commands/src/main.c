@@ -0,0 +1,373 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Send the line tracking and color connected components commands to the
+ * emulated cameras, over both transports, and check their results against
+ * the emulator state and scripted content. With RTIO, also acquire frames
+ * through the pipeline, which overlaps them.
+ */
+
+#include <zephyr/drivers/emul.h>
+#include <zephyr/ztest.h>
+
+#include "pixy2_command.h"
+#include "pixy2_emul.h"
+#include "pixy2_tracker.h"
+
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+#include "pixy2_pipeline.h"
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
+
+/* number of RTIO queue entries - enough for one request/reply pair */
+#define PIXY2_RTIO_QUEUE_SIZE	4
+
+/* how long to wait for the camera to serve a new frame */
+#define FRAME_TIMEOUT_MS	100
+
+/* number of frames the blocks are tracked for */
+#define TRACKED_FRAMES		4
+
+/* number of frames acquired through the pipeline */
+#define PIPELINED_FRAMES	4
+
+/* the emulator numbers its frames through the barcode value, modulo 16 */
+#define FRAME_CODE(code)	((code) % 16)
+
+struct camera {
+	struct pixy2_transport *t;
+	const struct emul *emul;
+};
+
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+RTIO_DEFINE(pixy2_i2c_rtio, PIXY2_RTIO_QUEUE_SIZE, PIXY2_RTIO_QUEUE_SIZE);
+RTIO_DEFINE(pixy2_spi_rtio, PIXY2_RTIO_QUEUE_SIZE, PIXY2_RTIO_QUEUE_SIZE);
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
+
+static struct pixy2_i2c_transport i2c_transport = {
+	.t.ctlr = DEVICE_DT_GET(DT_NODELABEL(lpi2c3)),
+	.t.name = "i2c",
+	.t.api = COND_CODE_1(CONFIG_NXPCUP_PIXY2_I2C_COMBINED,
+			     (&pixy2_transport_i2c_xfer_api),
+			     (&pixy2_transport_i2c_api)),
+	IF_ENABLED(CONFIG_NXPCUP_PIXY2_RTIO, (.t.r = &pixy2_i2c_rtio,))
+	.address = DT_REG_ADDR(DT_CHILD(DT_NODELABEL(lpi2c3), pixy2_54)),
+};
+
+static struct pixy2_spi_transport spi_transport = {
+	.t.ctlr = DEVICE_DT_GET(DT_NODELABEL(lpspi3)),
+	.t.name = "spi0",
+	.t.api = &pixy2_transport_spi_api,
+	IF_ENABLED(CONFIG_NXPCUP_PIXY2_RTIO, (.t.r = &pixy2_spi_rtio,))
+	.sidx = DT_REG_ADDR(DT_CHILD(DT_NODELABEL(lpspi3), pixy2_0)),
+};
+
+static const struct camera cameras[] = {
+	{
+		.t = &i2c_transport.t,
+		.emul = EMUL_DT_GET(DT_CHILD(DT_NODELABEL(lpi2c3), pixy2_54)),
+	},
+	{
+		.t = &spi_transport.t,
+		.emul = EMUL_DT_GET(DT_CHILD(DT_NODELABEL(lpspi3), pixy2_0)),
+	},
+};
+
+static struct pixy2_features features;
+static struct pixy2_blocks blocks;
+
+static struct pixy2_emul_line get_line(const struct camera *cam)
+{
+	struct pixy2_emul_line line;
+
+	zassert_ok(pixy2_emul_get_line(cam->emul, &line));
+
+	return line;
+}
+
+/* the camera only answers once per frame, wait for the next one */
+static void get_features(const struct camera *cam)
+{
+	int ret;
+	int64_t timeout = k_uptime_get() + FRAME_TIMEOUT_MS;
+
+	do {
+		ret = pixy2_get_main_features(cam->t, PIXY2_LINE_VECTOR,
+					      &features);
+		if (ret == -EBUSY) {
+			k_sleep(K_MSEC(1));
+		}
+	} while (ret == -EBUSY && k_uptime_get() < timeout);
+
+	zassert_ok(ret, "%s: failed to get features", cam->t->name);
+}
+
+static void get_blocks(const struct camera *cam, uint8_t sigmap,
+		       uint8_t max_blocks)
+{
+	int ret;
+	int64_t timeout = k_uptime_get() + FRAME_TIMEOUT_MS;
+
+	do {
+		ret = pixy2_get_blocks(cam->t, sigmap, max_blocks, &blocks);
+		if (ret == -EBUSY) {
+			k_sleep(K_MSEC(1));
+		}
+	} while (ret == -EBUSY && k_uptime_get() < timeout);
+
+	zassert_ok(ret, "%s: failed to get blocks", cam->t->name);
+}
+
+ZTEST(pixy2_commands, test_set_mode)
+{
+	const struct camera *cam;
+
+	ARRAY_FOR_EACH_PTR(cameras, cam) {
+		zassert_ok(pixy2_set_mode(cam->t, PIXY2_LINE_MODE_WHITE_LINE |
+					  PIXY2_LINE_MODE_TURN_DELAYED));
+		zassert_equal(get_line(cam).mode, PIXY2_LINE_MODE_WHITE_LINE |
+			      PIXY2_LINE_MODE_TURN_DELAYED);
+
+		/* unknown modes are rejected and leave the mode untouched */
+		zassert_equal(pixy2_set_mode(cam->t, BIT(3)), -EIO);
+		zassert_equal(get_line(cam).mode, PIXY2_LINE_MODE_WHITE_LINE |
+			      PIXY2_LINE_MODE_TURN_DELAYED);
+	}
+}
+
+ZTEST(pixy2_commands, test_set_vector)
+{
+	const struct camera *cam;
+
+	ARRAY_FOR_EACH_PTR(cameras, cam) {
+		zassert_ok(pixy2_set_vector(cam->t, 1));
+		zassert_equal(get_line(cam).vector, 1);
+
+		/* there are only two vectors to pick from */
+		zassert_equal(pixy2_set_vector(cam->t, 2), -EIO);
+		zassert_equal(get_line(cam).vector, 1);
+	}
+}
+
+ZTEST(pixy2_commands, test_set_turns)
+{
+	const struct camera *cam;
+
+	ARRAY_FOR_EACH_PTR(cameras, cam) {
+		zassert_ok(pixy2_set_next_turn(cam->t, -45));
+		zassert_ok(pixy2_set_default_turn(cam->t, 90));
+
+		zassert_equal(get_line(cam).next_turn, -45);
+		zassert_equal(get_line(cam).default_turn, 90);
+	}
+}
+
+ZTEST(pixy2_commands, test_reverse_vector)
+{
+	const struct camera *cam;
+
+	ARRAY_FOR_EACH_PTR(cameras, cam) {
+		zassert_ok(pixy2_set_vector(cam->t, 0));
+
+		zassert_ok(pixy2_reverse_vector(cam->t));
+		zassert_equal(get_line(cam).reversed, BIT(0));
+
+		/* reversing twice goes back to the original direction */
+		zassert_ok(pixy2_reverse_vector(cam->t));
+		zassert_equal(get_line(cam).reversed, 0);
+	}
+}
+
+ZTEST(pixy2_commands, test_manual_select_vector)
+{
+	const struct camera *cam;
+	const struct pixy2_vector *v;
+
+	ARRAY_FOR_EACH_PTR(cameras, cam) {
+		zassert_ok(pixy2_set_mode(cam->t,
+					  PIXY2_LINE_MODE_MANUAL_SELECT_VECTOR));
+		zassert_ok(pixy2_set_vector(cam->t, 1));
+
+		/* only the selected vector is left, pointing away */
+		get_features(cam);
+		zassert_equal(features.num_vectors, 1);
+
+		v = &features.vectors[0];
+		zassert_equal(v->index, 1);
+		zassert_true(v->y0 > v->y1);
+
+		/* ... or towards the car once reversed */
+		zassert_ok(pixy2_reverse_vector(cam->t));
+
+		get_features(cam);
+		zassert_equal(features.num_vectors, 1);
+
+		v = &features.vectors[0];
+		zassert_equal(v->index, 1);
+		zassert_true(v->y0 < v->y1);
+
+		zassert_ok(pixy2_reverse_vector(cam->t));
+	}
+}
+
+ZTEST(pixy2_commands, test_get_blocks)
+{
+	const struct camera *cam;
+	const struct pixy2_block *b;
+
+	ARRAY_FOR_EACH_PTR(cameras, cam) {
+		/* one block per signature 1 and 2 */
+		get_blocks(cam, PIXY2_SIGNATURE_ALL, PIXY2_MAX_BLOCKS);
+		zassert_equal(blocks.num_blocks, 2);
+
+		b = &blocks.blocks[0];
+		zassert_equal(b->signature, 1);
+		zassert_equal(b->index, 0);
+		zassert_equal(b->width, 20);
+		zassert_equal(b->height, 30);
+
+		b = &blocks.blocks[1];
+		zassert_equal(b->signature, 2);
+		zassert_equal(b->index, 1);
+
+		/* only the requested signatures, no more than requested */
+		get_blocks(cam, PIXY2_SIGNATURE(2), PIXY2_MAX_BLOCKS);
+		zassert_equal(blocks.num_blocks, 1);
+		zassert_equal(blocks.blocks[0].signature, 2);
+
+		get_blocks(cam, PIXY2_SIGNATURE_ALL, 1);
+		zassert_equal(blocks.num_blocks, 1);
+		zassert_equal(blocks.blocks[0].signature, 1);
+	}
+}
+
+ZTEST(pixy2_commands, test_track_blocks)
+{
+	int i;
+	bool moved;
+	const struct camera *cam;
+	const struct pixy2_track *t0, *t1;
+	struct pixy2_tracker tr;
+
+	ARRAY_FOR_EACH_PTR(cameras, cam) {
+		tr = (struct pixy2_tracker)PIXY2_TRACKER(0);
+		moved = false;
+
+		for (i = 0; i < TRACKED_FRAMES; i++) {
+			get_blocks(cam, PIXY2_SIGNATURE_ALL, PIXY2_MAX_BLOCKS);
+			zassert_equal(pixy2_tracker_update(&tr, &blocks), 0);
+
+			t0 = pixy2_tracker_find(&tr, 0);
+			t1 = pixy2_tracker_find(&tr, 1);
+			zassert_not_null(t0);
+			zassert_not_null(t1);
+
+			/* the blocks move in opposite directions */
+			zassert_equal(t0->dx, -t1->dx);
+			zassert_equal(t0->dy, 0);
+			moved |= t0->dx != 0;
+		}
+
+		zassert_true(moved, "%s: blocks didn't move", cam->t->name);
+	}
+}
+
+#ifdef CONFIG_NXPCUP_PIXY2_RTIO
+static struct pixy2_pipeline pipeline;
+
+/* poll the pipeline like a control loop would, between two iterations */
+static int pipeline_get(struct pixy2_features **f, int *polls)
+{
+	int ret;
+	int64_t timeout = k_uptime_get() + FRAME_TIMEOUT_MS;
+
+	do {
+		ret = pixy2_pipeline_get(&pipeline, f, false);
+		if (ret == -EAGAIN) {
+			(*polls)++;
+			k_sleep(K_MSEC(1));
+		}
+	} while (ret == -EAGAIN && k_uptime_get() < timeout);
+
+	return ret;
+}
+
+ZTEST(pixy2_commands, test_pipeline)
+{
+	int i, code, polls;
+	const struct camera *cam;
+	struct pixy2_features *cur, *next;
+
+	ARRAY_FOR_EACH_PTR(cameras, cam) {
+		pipeline = (struct pixy2_pipeline)
+			PIXY2_PIPELINE(cam->t, PIXY2_LINE_VECTOR | PIXY2_LINE_BARCODE);
+		polls = 0;
+
+		zassert_ok(pixy2_pipeline_start(&pipeline));
+		zassert_equal(pixy2_pipeline_start(&pipeline), -EALREADY);
+
+		zassert_ok(pipeline_get(&cur, &polls));
+		zassert_equal(cur->num_barcodes, 1);
+		code = cur->barcodes[0].code;
+
+		for (i = 1; i < PIPELINED_FRAMES; i++) {
+			/* the next frame needs the buffer held by the application */
+			zassert_equal(pixy2_pipeline_get(&pipeline, &next, false),
+				      -EBUSY);
+
+			/* ... which the request in flight leaves alone */
+			k_sleep(K_MSEC(1));
+			zassert_equal(cur->barcodes[0].code, code);
+
+			pixy2_pipeline_put(&pipeline, cur);
+
+			zassert_ok(pipeline_get(&next, &polls));
+			zassert_not_equal(next, cur);
+
+			/* frames come back in order, none skipped */
+			zassert_equal(next->num_vectors, 2);
+			zassert_equal(next->num_barcodes, 1);
+			zassert_equal(next->barcodes[0].code, FRAME_CODE(code + 1),
+				      "%s: frame %d follows frame %d", cam->t->name,
+				      next->barcodes[0].code, code);
+
+			cur = next;
+			code = cur->barcodes[0].code;
+		}
+
+		/* requests sent too early were re-issued */
+		zassert_true(polls > 0);
+
+		pixy2_pipeline_put(&pipeline, cur);
+		pixy2_pipeline_stop(&pipeline);
+	}
+}
+#endif /* CONFIG_NXPCUP_PIXY2_RTIO */
+
+static void pixy2_commands_before(void *fixture)
+{
+	const struct camera *cam;
+
+	ARG_UNUSED(fixture);
+
+	/* start each test from the camera's default settings */
+	ARRAY_FOR_EACH_PTR(cameras, cam) {
+		zassert_ok(pixy2_set_mode(cam->t, 0));
+		zassert_ok(pixy2_set_vector(cam->t, 0));
+	}
+}
+
+static void *pixy2_commands_setup(void)
+{
+	const struct camera *cam;
+
+	ARRAY_FOR_EACH_PTR(cameras, cam) {
+		zassert_ok(pixy2_transport_recover(cam->t));
+	}
+
+	return NULL;
+}
+
+ZTEST_SUITE(pixy2_commands, NULL, pixy2_commands_setup,
+	    pixy2_commands_before, NULL, NULL);
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2025 NXP
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Feed the block tracker with scripted frames and check the tracks it
+ * keeps across them.
+ */
+
+#include <zephyr/ztest.h>
+
+#include "pixy2_tracker.h"
+
+/* frames an object may go unseen for before its track is dropped */
+#define MAX_MISSED	2
+
+#define BLOCK(_index, _x, _y, _age)					\
+	{ .signature = 1, .index = _index, .x = _x, .y = _y, .age = _age }
+
+static struct pixy2_tracker tr;
+
+static int update(const struct pixy2_block *blocks, uint8_t num)
+{
+	struct pixy2_blocks b = {
+		.blocks = blocks,
+		.num_blocks = num,
+	};
+
+	return pixy2_tracker_update(&tr, &b);
+}
+
+ZTEST(pixy2_tracker, test_displacement)
+{
+	const struct pixy2_track *track;
+	static const struct pixy2_block f0[] = {
+		BLOCK(3, 100, 50, 1),
+		BLOCK(7, 200, 60, 1),
+	};
+	static const struct pixy2_block f1[] = {
+		/* the camera doesn't keep the blocks in the same order */
+		BLOCK(7, 195, 66, 2),
+		BLOCK(3, 104, 48, 2),
+	};
+
+	zassert_equal(update(f0, ARRAY_SIZE(f0)), 0);
+
+	/* new objects start without any displacement */
+	track = pixy2_tracker_find(&tr, 3);
+	zassert_not_null(track);
+	zassert_equal(track->dx, 0);
+	zassert_equal(track->dy, 0);
+
+	zassert_equal(update(f1, ARRAY_SIZE(f1)), 0);
+
+	track = pixy2_tracker_find(&tr, 3);
+	zassert_not_null(track);
+	zassert_equal(track->dx, 4);
+	zassert_equal(track->dy, -2);
+	zassert_equal(track->block.age, 2);
+
+	track = pixy2_tracker_find(&tr, 7);
+	zassert_not_null(track);
+	zassert_equal(track->dx, -5);
+	zassert_equal(track->dy, 6);
+
+	zassert_is_null(pixy2_tracker_find(&tr, 0));
+}
+
+ZTEST(pixy2_tracker, test_age_reset)
+{
+	const struct pixy2_track *track;
+	static const struct pixy2_block f0[] = { BLOCK(3, 100, 50, 40) };
+	static const struct pixy2_block f1[] = { BLOCK(3, 110, 50, 41) };
+	/* index 3 now belongs to another object, far from the first one */
+	static const struct pixy2_block f2[] = { BLOCK(3, 250, 150, 1) };
+	static const struct pixy2_block f3[] = { BLOCK(3, 245, 151, 2) };
+
+	update(f0, ARRAY_SIZE(f0));
+	update(f1, ARRAY_SIZE(f1));
+
+	track = pixy2_tracker_find(&tr, 3);
+	zassert_equal(track->dx, 10);
+
+	/* no jump from the previous object to the new one */
+	update(f2, ARRAY_SIZE(f2));
+
+	track = pixy2_tracker_find(&tr, 3);
+	zassert_not_null(track);
+	zassert_equal(track->dx, 0);
+	zassert_equal(track->dy, 0);
+	zassert_equal(track->block.x, 250);
+	zassert_equal(track->block.age, 1);
+
+	/* the new object is then followed as usual */
+	update(f3, ARRAY_SIZE(f3));
+
+	track = pixy2_tracker_find(&tr, 3);
+	zassert_equal(track->dx, -5);
+	zassert_equal(track->dy, 1);
+}
+
+ZTEST(pixy2_tracker, test_missed)
+{
+	int i;
+	const struct pixy2_track *track;
+	static const struct pixy2_block f0[] = {
+		BLOCK(3, 100, 50, 1),
+		BLOCK(7, 200, 60, 1),
+	};
+
+	update(f0, ARRAY_SIZE(f0));
+
+	/* index 7 goes unseen, which is tolerated for a few frames */
+	for (i = 1; i <= MAX_MISSED; i++) {
+		update(f0, 1);
+
+		track = pixy2_tracker_find(&tr, 7);
+		zassert_not_null(track);
+		zassert_equal(track->missed, i);
+	}
+
+	update(f0, 1);
+	zassert_is_null(pixy2_tracker_find(&tr, 7));
+
+	/* the object that was seen all along is still tracked */
+	track = pixy2_tracker_find(&tr, 3);
+	zassert_not_null(track);
+	zassert_equal(track->missed, 0);
+}
+
+ZTEST(pixy2_tracker, test_slot_reuse)
+{
+	int i;
+	const struct pixy2_track *dropped, *track;
+	static const struct pixy2_block f0[] = {
+		BLOCK(3, 100, 50, 1),
+		BLOCK(7, 200, 60, 1),
+	};
+	static const struct pixy2_block f1[] = {
+		BLOCK(3, 100, 50, 2),
+		BLOCK(9, 10, 20, 1),
+	};
+
+	update(f0, ARRAY_SIZE(f0));
+	dropped = pixy2_tracker_find(&tr, 7);
+
+	/* drop index 7 */
+	for (i = 0; i <= MAX_MISSED; i++) {
+		update(f0, 1);
+	}
+
+	zassert_is_null(pixy2_tracker_find(&tr, 7));
+
+	/* the next new object gets the slot index 7 left behind */
+	update(f1, ARRAY_SIZE(f1));
+
+	track = pixy2_tracker_find(&tr, 9);
+	zassert_equal_ptr(track, dropped);
+	zassert_equal(track->block.x, 10);
+	zassert_equal(track->dx, 0);
+	zassert_equal(track->missed, 0);
+
+	zassert_is_null(pixy2_tracker_find(&tr, 7));
+	zassert_not_null(pixy2_tracker_find(&tr, 3));
+}
+
+ZTEST(pixy2_tracker, test_full)
+{
+	int i;
+	struct pixy2_block f[PIXY2_TRACKER_MAX_TRACKS];
+
+	for (i = 0; i < ARRAY_SIZE(f); i++) {
+		f[i] = (struct pixy2_block)BLOCK(i, i, i, 1);
+	}
+
+	zassert_equal(update(f, ARRAY_SIZE(f)), 0);
+
+	/* new objects don't fit until the previous ones are dropped */
+	for (i = 0; i < ARRAY_SIZE(f); i++) {
+		f[i].index += PIXY2_TRACKER_MAX_TRACKS;
+	}
+
+	zassert_equal(update(f, ARRAY_SIZE(f)), PIXY2_TRACKER_MAX_TRACKS);
+	zassert_is_null(pixy2_tracker_find(&tr, PIXY2_TRACKER_MAX_TRACKS));
+
+	for (i = 1; i < MAX_MISSED; i++) {
+		update(f, 0);
+	}
+
+	/* the last frame the previous objects may be missing from */
+	zassert_equal(update(f, ARRAY_SIZE(f)), PIXY2_TRACKER_MAX_TRACKS);
+	zassert_equal(update(f, ARRAY_SIZE(f)), 0);
+	zassert_not_null(pixy2_tracker_find(&tr, PIXY2_TRACKER_MAX_TRACKS));
+	zassert_is_null(pixy2_tracker_find(&tr, 0));
+}
+
+static void pixy2_tracker_before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	tr = (struct pixy2_tracker)PIXY2_TRACKER(MAX_MISSED);
+}
+
+ZTEST_SUITE(pixy2_tracker, NULL, NULL, pixy2_tracker_before, NULL, NULL);